@@ -4,6 +4,7 @@
     #include <argp.h>
 #endif
 #include <sokol_args.h>
+#include <stdlib.h>
 
 #define BUGS_ADDRESS "https://github.com/X65/emu/issues"
 const char* app_bug_address = BUGS_ADDRESS;
@@ -12,7 +13,7 @@ const char* app_releases_address = "https://github.com/X65/emu/releases";
 const char full_name[] = FULL_NAME;
 
 struct arguments arguments = {
-    NULL, "-", false, false, false, false, false, false, false, NULL, NULL,
+    NULL, "-", false, false, false, false, false, false, false, false, false, NULL, NULL, 0,
 };
 static char args_doc[] = "[ROM.xex]";
 
@@ -33,6 +34,9 @@ static struct argp_option options[] = {
       "list of up to 6 floats: scanlines,mask,curvature,vignette,blur,gamma "
       "(empty positions keep current values)" },
     { "fullscreen", 'f', 0, 0, "Start in fullscreen mode" },
+    { "warp", 'w', 0, 0, "Start in warp mode, running as fast as possible" },
+    { "run-ahead", 'r', "N", 0, "Show the frame N frames ahead to cut input latency (experimental)" },
+    { "frame-skip", 'k', 0, 0, "Skip rendering frames when the host can't keep up" },
     { 0 }
 };
 
@@ -55,6 +59,9 @@ static error_t parse_opt(int key, char* arg, struct argp_state* argp_state) {
             }
             break;
         case 'f': args->fullscreen = true; break;
+        case 'w': args->warp = true; break;
+        case 'r': args->run_ahead = atoi(arg); break;
+        case 'k': args->frame_skip = true; break;
 
         case 'l': app_load_labels(arg, false); break;
 
@@ -97,4 +104,13 @@ void args_parse(int argc, char* argv[]) {
     if (sargs_exists("fullscreen")) {
         arguments.fullscreen = true;
     }
+    if (sargs_exists("warp")) {
+        arguments.warp = true;
+    }
+    if (sargs_exists("frameskip")) {
+        arguments.frame_skip = true;
+    }
+    if (sargs_exists("runahead")) {
+        arguments.run_ahead = atoi(sargs_value("runahead"));
+    }
 }
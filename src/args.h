@@ -12,9 +12,10 @@ extern char program_version[];
 extern struct arguments {
     const char* rom;
     const char* output_file;
-    bool silent, verbose, zeromem, joy, dap, crt, fullscreen;
+    bool silent, verbose, zeromem, joy, dap, crt, fullscreen, warp, frame_skip;
     const char* dap_port;
     const char* crt_values;
+    int run_ahead;
 } arguments;
 
 void args_parse(int argc, char* argv[]);
@@ -9,6 +9,7 @@
 
 #include "firmware/src/south/hw.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -19,25 +20,228 @@
 
 #include "../log.h"
 
+// vectorized bitmap and affine encoders, CGIA_NO_SIMD keeps the scalar reference encoders,
+// the NEON encoders are opt-in with CGIA_NEON
+#if defined(CGIA_NEON) && !(defined(__ARM_NEON) && defined(__aarch64__))
+    #error "CGIA_NEON needs an AArch64 target"
+#endif
+#if !defined(CGIA_NO_SIMD) && (defined(__SSE2__) || defined(CGIA_NEON))
+    #define CGIA_SIMD
+    #if defined(__SSE2__)
+        #include <immintrin.h>
+    #else
+        #include <arm_neon.h>
+    #endif
+#endif
+
 #define _CGIA_CLAMP(x) ((x) > 255 ? 255 : (x))
 #define _CGIA_RGBA(r, g, b) \
     (0xFF000000 | _CGIA_CLAMP((r * 4) / 3) | (_CGIA_CLAMP((g * 4) / 3) << 8) | (_CGIA_CLAMP((b * 4) / 3) << 16))
 
-// used to access regs from firmware render function which expects global symbol
+// a linebuffer pixel of hardware color idx, and of an RGB color computed by
+// the rasterizer, an indexed framebuffer leaves the palette to the display
+#ifdef CGIA_INDEXED_FB
+    #define CGIA_PIXEL(idx)     (idx)
+    #define CGIA_RGB_PIXEL(rgb) _cgia_rgb_index[_CGIA_RGB15(rgb)]
+    #define CGIA_FB_PIXEL(p)    ((cgia_pixel_t)(p))
+#else
+    #define CGIA_PIXEL(idx)     cgia_rgb_palette[idx]
+    #define CGIA_RGB_PIXEL(rgb) (rgb)
+    #define CGIA_FB_PIXEL(p)    ((p) | 0xFF000000)  // set ALPHA channel to 100% opacity
+#endif
+
+#ifdef CGIA_INDEXED_FB
+#define _CGIA_RGB15(c) ((((c) >> 3) & 0x1F) | (((c) >> 6) & 0x3E0) | (((c) >> 9) & 0x7C00))
+
+// nearest hardware color of each 15-bit RGB color, for MODE6 colors which
+// are computed channel by channel and don't need to be in the palette
+static uint8_t _cgia_rgb_index[1 << 15];
+
+static void _cgia_init_rgb_index(void) {
+    for (uint32_t rgb15 = 0; rgb15 < (1 << 15); rgb15++) {
+        const int r = ((rgb15 << 3) & 0xF8) | 4;
+        const int g = ((rgb15 >> 2) & 0xF8) | 4;
+        const int b = ((rgb15 >> 7) & 0xF8) | 4;
+        uint32_t best_dist = UINT32_MAX;
+        for (int i = 0; i < CGIA_HWCOLOR_NUM; i++) {
+            const uint32_t c = cgia_rgb_palette[i];
+            const int dr = r - (int)(c & 0xFF);
+            const int dg = g - (int)((c >> 8) & 0xFF);
+            const int db = b - (int)((c >> 16) & 0xFF);
+            const uint32_t dist = (uint32_t)(dr * dr + dg * dg + db * db);
+            if (dist < best_dist) {
+                best_dist = dist;
+                _cgia_rgb_index[rgb15] = (uint8_t)i;
+            }
+        }
+    }
+}
+#endif
+
+#ifdef CGIA_SIMD
+// the vectorized encoders are used, see cgia_set_simd(), which may be called
+// from another thread than the one ticking the CGIA
+static atomic_bool _cgia_simd = true;
+
+// color indices of the pixels of a bitmap byte, first pixel in the lowest nibble
+static uint32_t _cgia_nibbles_1bpp[256];
+static uint16_t _cgia_nibbles_2bpp[256];
+
+static void _cgia_init_nibbles(void) {
+    for (uint b = 0; b < 256; ++b) {
+        uint32_t n1 = 0, n2 = 0;
+        for (uint p = 0; p < 8; ++p) n1 |= ((b >> (7 - p)) & 0b1) << (4 * p);
+        for (uint p = 0; p < 4; ++p) n2 |= ((b >> (6 - 2 * p)) & 0b11) << (4 * p);
+        _cgia_nibbles_1bpp[b] = n1;
+        _cgia_nibbles_2bpp[b] = (uint16_t)n2;
+    }
+}
+
+// color indices of the 8 pixels of a bpp bits per pixel chunk, first pixel in the lowest nibble
+static inline uint32_t _cgia_nibbles(uint32_t chunk, uint8_t bpp) {
+    switch (bpp) {
+        case 1: return _cgia_nibbles_1bpp[chunk];
+        case 2: return _cgia_nibbles_2bpp[chunk >> 8] | ((uint32_t)_cgia_nibbles_2bpp[chunk & 0xFF] << 16);
+        case 4:
+            chunk = __builtin_bswap32(chunk);
+            return ((chunk >> 4) & 0x0F0F0F0F) | ((chunk & 0x0F0F0F0F) << 4);
+        default: {
+            uint32_t nibbles = 0;
+            for (uint p = 0; p < 8; ++p) nibbles |= ((chunk >> (21 - 3 * p)) & 0b111) << (4 * p);
+            return nibbles;
+        }
+    }
+}
+
+// 4 lanes of uint32_t, SSE2 (with AVX2 variable shifts and gathers when available) or NEON
+#if defined(__SSE2__)
+typedef __m128i cgia_v4_t;
+    #define _cgia_v4_dup(x)          _mm_set1_epi32((int)(x))
+    #define _cgia_v4_set(a, b, c, d) _mm_setr_epi32((int)(a), (int)(b), (int)(c), (int)(d))
+    #define _cgia_v4_add(a, b)       _mm_add_epi32(a, b)
+    #define _cgia_v4_and(a, b)       _mm_and_si128(a, b)
+    #define _cgia_v4_shr(a, n)       _mm_srl_epi32(a, _mm_cvtsi32_si128((int)(n)))
+    #define _cgia_v4_store(p, a)     _mm_storeu_si128((__m128i*)(p), a)
+#else
+typedef uint32x4_t cgia_v4_t;
+    #define _cgia_v4_dup(x)          vdupq_n_u32((uint32_t)(x))
+    #define _cgia_v4_set(a, b, c, d) ((uint32x4_t){ (a), (b), (c), (d) })
+    #define _cgia_v4_add(a, b)       vaddq_u32(a, b)
+    #define _cgia_v4_and(a, b)       vandq_u32(a, b)
+    #define _cgia_v4_shr(a, n)       vshlq_u32(a, vdupq_n_s32(-(int32_t)(n)))
+    #define _cgia_v4_store(p, a)     vst1q_u32(p, a)
+#endif
+
+// store 4 pixels, unless opaque keeping the pixels in dst where keep is set
+static inline void _cgia_store4(uint32_t* dst, cgia_v4_t px, cgia_v4_t keep, bool opaque) {
+#if defined(__SSE2__)
+    if (!opaque) {
+        const __m128i old = _mm_loadu_si128((const __m128i*)dst);
+        px = _mm_or_si128(_mm_and_si128(keep, old), _mm_andnot_si128(keep, px));
+    }
+    _mm_storeu_si128((__m128i*)dst, px);
+#else
+    vst1q_u32(dst, opaque ? px : vbslq_u32(keep, vld1q_u32(dst), px));
+#endif
+}
+
+// expand the 4 color indices in the low nibbles through lut into 4 pixels (8 if doubled),
+// color index 0 is transparent unless opaque0
+static inline uint32_t* _cgia_put4(uint32_t* dst, const uint32_t lut[16], uint32_t nibbles, bool opaque0, bool doubled) {
+#if defined(__AVX2__)
+    const __m128i idx = _mm_and_si128(_mm_srlv_epi32(_mm_set1_epi32((int)nibbles), _mm_setr_epi32(0, 4, 8, 12)), _mm_set1_epi32(0xF));
+    const __m128i px = _mm_i32gather_epi32((const int*)lut, idx, 4);
+    const __m128i keep = opaque0 ? _mm_setzero_si128() : _mm_cmpeq_epi32(idx, _mm_setzero_si128());
+#elif defined(__SSE2__)
+    const uint32_t i0 = nibbles & 0xF, i1 = (nibbles >> 4) & 0xF, i2 = (nibbles >> 8) & 0xF, i3 = (nibbles >> 12) & 0xF;
+    const __m128i px = _cgia_v4_set(lut[i0], lut[i1], lut[i2], lut[i3]);
+    const __m128i keep = opaque0 ? _mm_setzero_si128() : _mm_cmpeq_epi32(_cgia_v4_set(i0, i1, i2, i3), _mm_setzero_si128());
+#else
+    // the lookup table is 64 bytes, the lanes pick the 4 bytes of their entry
+    const uint32x4_t idx = vandq_u32(vshlq_u32(vdupq_n_u32(nibbles), (int32x4_t){ 0, -4, -8, -12 }), vdupq_n_u32(0xF));
+    const uint8x16_t bytes = vreinterpretq_u8_u32(vmlaq_n_u32(vdupq_n_u32(0x03020100), idx, 0x04040404));
+    const uint32x4_t px = vreinterpretq_u32_u8(vqtbl4q_u8(vld1q_u8_x4((const uint8_t*)lut), bytes));
+    const uint32x4_t keep = opaque0 ? vdupq_n_u32(0) : vceqq_u32(idx, vdupq_n_u32(0));
+#endif
+    if (!doubled) {
+        _cgia_store4(dst, px, keep, opaque0);
+        return dst + 4;
+    }
+#if defined(__SSE2__)
+    _cgia_store4(dst, _mm_unpacklo_epi32(px, px), _mm_unpacklo_epi32(keep, keep), opaque0);
+    _cgia_store4(dst + 4, _mm_unpackhi_epi32(px, px), _mm_unpackhi_epi32(keep, keep), opaque0);
+#else
+    _cgia_store4(dst, vzip1q_u32(px, px), vzip1q_u32(keep, keep), opaque0);
+    _cgia_store4(dst + 4, vzip2q_u32(px, px), vzip2q_u32(keep, keep), opaque0);
+#endif
+    return dst + 8;
+}
+
+// 4 pixels of the texels at the given texture offsets
+static inline uint32_t* _cgia_put_texels4(uint32_t* dst, const uint8_t* texture, const uint32_t offset[4]) {
+#if defined(__AVX2__) && !defined(CGIA_INDEXED_FB)
+    const __m128i texels = _cgia_v4_set(texture[offset[0]], texture[offset[1]], texture[offset[2]], texture[offset[3]]);
+    _mm_storeu_si128((__m128i*)dst, _mm_i32gather_epi32((const int*)cgia_rgb_palette, texels, 4));
+#else
+    for (uint p = 0; p < 4; ++p) dst[p] = CGIA_PIXEL(texture[offset[p]]);
+#endif
+    return dst + 4;
+}
+#endif
+
+#if defined(CGIA_INDEXED_FB) || defined(CGIA_SIMD)
+// lookup tables shared by all instances, built by the first cgia_init(),
+// concurrent callers wait until the tables are complete
+static void _cgia_init_tables(void) {
+    static atomic_int state = 0;  // 0: not built, 1: building, 2: built
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&state, &expected, 1)) {
+    #ifdef CGIA_INDEXED_FB
+        _cgia_init_rgb_index();
+    #endif
+    #ifdef CGIA_SIMD
+        _cgia_init_nibbles();
+    #endif
+        atomic_store(&state, 2);
+    }
+    else {
+        while (atomic_load(&state) != 2) continue;
+    }
+}
+#endif
+
+// used to access regs from firmware render function which expects global symbol,
+// the firmware keeps the rest of its state in globals too, so there is only
+// one CGIA per process and this is the instance last initialized or ticked
 static cgia_t* CGIA_vpu;
-static bool NMI_flag = false;
 
 static void _copy_internal_regs(cgia_t* vpu);
 static void _vcache_dma_process_block(cgia_t* vpu);
+static uint64_t _cgia_line_inputs(uint16_t line);
+static uint64_t _cgia_line_signature(const cgia_t* vpu, uint64_t inputs, const uint32_t* pages);
+static void _cgia_track_begin(void);
+static void _cgia_track_end(uint32_t* pages);
+
+// firmware function syncing RAM writes into the VRAM cache
+void cgia_ram_write(uint8_t bank, uint16_t addr, uint8_t data);
 
 void cgia_init(cgia_t* vpu, const cgia_desc_t* desc) {
     CHIPS_ASSERT(vpu && desc);
     CHIPS_ASSERT(desc->framebuffer.ptr && (desc->framebuffer.size == CGIA_FRAMEBUFFER_SIZE_BYTES));
+    CHIPS_ASSERT(!desc->line_sig.ptr || (desc->line_sig.size == CGIA_ACTIVE_HEIGHT * sizeof(cgia_line_sig_t)));
     CHIPS_ASSERT(desc->fetch_cb);
     CHIPS_ASSERT((desc->tick_hz > 0) && (desc->tick_hz < MODE_BIT_CLK_HZ));
 
     memset(vpu, 0, sizeof(*vpu));
     vpu->fb = desc->framebuffer.ptr;
+    vpu->line_sig = desc->line_sig.ptr;
+    if (vpu->line_sig) {
+        memset(vpu->line_sig, 0, desc->line_sig.size);
+    }
+    vpu->dirty = desc->dirty;
+    if (vpu->dirty) {
+        *vpu->dirty = CGIA_DIRTY_ALL;
+    }
     vpu->fetch_cb = desc->fetch_cb;
     vpu->user_data = desc->user_data;
 
@@ -49,6 +253,9 @@ void cgia_init(cgia_t* vpu, const cgia_desc_t* desc) {
     vpu->h_period = (int)tmp;
 
     vpu->hwcolors = cgia_rgb_palette;
+#if defined(CGIA_INDEXED_FB) || defined(CGIA_SIMD)
+    _cgia_init_tables();
+#endif
 
     vpu->vram[0] = vram_cache[0];
     vpu->vram[1] = vram_cache[1];
@@ -86,19 +293,53 @@ static uint64_t _cgia_tick(cgia_t* vpu, uint64_t pins) {
                 // rasterize new line
                 vpu->linebuffer_idx ^= 1;
                 src = vpu->linebuffer[vpu->linebuffer_idx] + CGIA_LINEBUFFER_PADDING;
-                cgia_render((uint16_t)(vpu->scan_line / FB_V_REPEAT), src);
+                // a line not copied to the framebuffer only advances the renderer scan state
+                const uint16_t line = (uint16_t)(vpu->scan_line / FB_V_REPEAT);
+                vpu->render_skip = vpu->fb_skip || vpu->frame_skipped;
+                cgia_line_sig_t* line_sig = 0;
+                uint64_t inputs = 0;
+                if (!vpu->render_skip && vpu->line_sig) {
+                    // the framebuffer still holds the line if its inputs and the
+                    // VRAM cache pages it read last time didn't change
+                    line_sig = &vpu->line_sig[line];
+                    inputs = _cgia_line_inputs(line);
+                    vpu->render_skip = (line_sig->sig == _cgia_line_signature(vpu, inputs, line_sig->pages));
+                }
+                if (line_sig && !vpu->render_skip) {
+                    _cgia_track_begin();
+                    cgia_render(line, src);
+                    _cgia_track_end(line_sig->pages);
+                    line_sig->sig = _cgia_line_signature(vpu, inputs, line_sig->pages);
+                }
+                else {
+                    cgia_render(line, src);
+                }
             }
 
-            uint32_t* dst = vpu->fb + (vpu->scan_line * CGIA_FRAMEBUFFER_WIDTH);
-            for (uint x = 0; x < CGIA_ACTIVE_WIDTH; ++x, ++src) {
-                for (uint r = 0; r < FB_H_REPEAT; ++r) {
-                    *dst++ = *src | 0xFF000000;  // set ALPHA channel to 100% opacity
+            // a native framebuffer gets each rasterized line once
+            const uint lines_per_row = FB_V_REPEAT / CGIA_FB_V_REPEAT;
+            if (!vpu->render_skip && (vpu->scan_line % lines_per_row == 0)) {
+                const uint16_t row = (uint16_t)(vpu->scan_line / lines_per_row);
+                if (vpu->dirty) {
+                    if (row < vpu->dirty->top) vpu->dirty->top = row;
+                    if (row >= vpu->dirty->bottom) vpu->dirty->bottom = row + 1;
+                }
+                cgia_pixel_t* dst = vpu->fb + (row * CGIA_FRAMEBUFFER_WIDTH);
+                for (uint x = 0; x < CGIA_ACTIVE_WIDTH; ++x, ++src) {
+                    for (uint r = 0; r < CGIA_FB_H_REPEAT; ++r) {
+                        *dst++ = CGIA_FB_PIXEL(*src);
+                    }
                 }
             }
         }
         else {
             vpu->chip[CGIA_REG_RASTER] = 0;
-            if (vpu->v_count == 0) cgia_vbi();
+            if (vpu->v_count == 0) {
+                cgia_vbi();
+                // rasterize one frame out of every frame_skip + 1
+                vpu->frame_skipped = vpu->frame_skip_count < vpu->frame_skip;
+                vpu->frame_skip_count = vpu->frame_skipped ? vpu->frame_skip_count + 1 : 0;
+            }
         }
     }
 
@@ -106,6 +347,8 @@ static uint64_t _cgia_tick(cgia_t* vpu, uint64_t pins) {
 }
 
 uint64_t cgia_tick(cgia_t* vpu, uint64_t pins) {
+    CGIA_vpu = vpu;
+
     // handle registers
     if (pins & CGIA_CS) {
         uint8_t addr = CGIA_GET_REG_ADDR(pins);
@@ -126,7 +369,7 @@ uint64_t cgia_tick(cgia_t* vpu, uint64_t pins) {
     _vcache_dma_process_block(vpu);
     _copy_internal_regs(vpu);
 
-    if (NMI_flag) {
+    if (vpu->nmi) {
         pins |= CGIA_INT;
     }
 
@@ -139,6 +382,8 @@ void cgia_snapshot_onsave(cgia_t* snapshot) {
     snapshot->fetch_cb = 0;
     snapshot->user_data = 0;
     snapshot->fb = 0;
+    snapshot->line_sig = 0;
+    snapshot->dirty = 0;
 }
 
 void cgia_snapshot_onload(cgia_t* snapshot, cgia_t* vpu) {
@@ -146,11 +391,16 @@ void cgia_snapshot_onload(cgia_t* snapshot, cgia_t* vpu) {
     snapshot->fetch_cb = vpu->fetch_cb;
     snapshot->user_data = vpu->user_data;
     snapshot->fb = vpu->fb;
+    snapshot->line_sig = vpu->line_sig;
+    snapshot->dirty = vpu->dirty;
+    snapshot->fb_skip = vpu->fb_skip;
+    snapshot->frame_skip = vpu->frame_skip;
 }
 
 static inline void gpio_put(uint gpio, bool value) {
     switch (gpio) {
-        case VPU_NMIB_PIN: NMI_flag = !value;  // on Emu side NMI is active HIGH
+        case VPU_NMIB_PIN:
+            if (CGIA_vpu) CGIA_vpu->nmi = !value;  // on Emu side NMI is active HIGH
     }
 }
 
@@ -166,16 +416,10 @@ typedef enum {
     INTERP_MODE7,
 } interp_mode_t;
 
-typedef struct {
-    uintptr_t accum[2];
-    uintptr_t base[3];
-    uint8_t shift[2];
-    uint32_t mask[2];
-} interp_hw_t;
+typedef cgia_interp_t interp_hw_t;
 
-static interp_hw_t interp_hw_array[2];
-#define interp0 (&interp_hw_array[0])
-#define interp1 (&interp_hw_array[1])
+#define interp0 (&CGIA_vpu->interp[0])
+#define interp1 (&CGIA_vpu->interp[1])
 
 typedef struct {
     uintptr_t accum[2];
@@ -184,6 +428,94 @@ typedef struct {
     uint32_t mask[2];
 } interp_hw_save_t;
 
+static_assert(CGIA_VRAM_CACHE_PAGES == (sizeof(vram_cache) >> 8), "CGIA_VRAM_CACHE_PAGES must match the firmware");
+
+// VRAM cache pages read by the line being rasterized, only tracked for lines
+// with a signature, and the interpolator accumulators at the start of the
+// current scan
+static bool _cgia_tracking;
+static uint32_t _cgia_read_pages[CGIA_VRAM_CACHE_PAGES / 32];
+static bool _cgia_scanning;
+static uintptr_t _cgia_scan_start[2][2];
+
+static inline uint32_t _cgia_vram_page(const uint8_t* ptr) {
+    return (uint32_t)((ptr - (const uint8_t*)vram_cache) >> 8);
+}
+
+// record the VRAM cache pages of the bytes from start to end, the parts outside of the cache are ignored
+static void _cgia_read_range(uintptr_t start, uintptr_t end) {
+    const uintptr_t lo = (uintptr_t)vram_cache;
+    const uintptr_t hi = lo + sizeof(vram_cache) - 1;
+    if (!_cgia_tracking || (end < lo) || (start > hi)) return;
+    const uint32_t last = (uint32_t)((((end > hi) ? hi : end) - lo) >> 8);
+    for (uint32_t page = (start < lo) ? 0 : (uint32_t)((start - lo) >> 8); page <= last; page++) {
+        _cgia_read_pages[page >> 5] |= 1U << (page & 31);
+    }
+}
+
+// the renderer sets up the interpolators to scan VRAM, a scan closed before the
+// interpolators are set up again records the VRAM range each lane went over
+static void _cgia_scan_open(void) {
+    if (!_cgia_tracking) return;
+    for (int i = 0; i < 2; i++) {
+        _cgia_scan_start[i][0] = CGIA_vpu->interp[i].accum[0];
+        _cgia_scan_start[i][1] = CGIA_vpu->interp[i].accum[1];
+    }
+    _cgia_scanning = true;
+}
+
+static void _cgia_scan_close(void) {
+    if (!_cgia_tracking || !_cgia_scanning) return;
+    const uintptr_t lo = (uintptr_t)vram_cache;
+    const uintptr_t hi = lo + sizeof(vram_cache);
+    for (int i = 0; i < 2; i++) {
+        const cgia_interp_t* interp = &CGIA_vpu->interp[i];
+        for (int lane = 0; lane < 2; lane++) {
+            // lanes not scanning VRAM hold texture coordinates
+            const uintptr_t start = _cgia_scan_start[i][lane];
+            if ((start >= lo) && (start < hi)) {
+                // pops read up to the accumulator, peeks one step further
+                const uintptr_t end = interp->accum[lane] + interp->base[lane];
+                _cgia_read_range(start, (end > start) ? end : start);
+            }
+        }
+        // MODE7 texture, lane 2 reads base[2] plus the masked lanes
+        if (interp->mask[0] | interp->mask[1]) {
+            _cgia_read_range(interp->base[2], interp->base[2] + interp->mask[0] + interp->mask[1]);
+        }
+    }
+    _cgia_scanning = false;
+}
+
+// the display lists and sprite descriptors of all planes, in either VRAM cache bank
+static void _cgia_read_planes(void) {
+    for (int slot = 0; slot < 2; slot++) {
+        const uintptr_t cache = (uintptr_t)vram_cache[slot];
+        for (int p = 0; p < CGIA_PLANES; p++) {
+            // longest display list instruction with its operands
+            _cgia_read_range(cache + CGIA.offset[p], cache + CGIA.offset[p] + 15);
+            for (int s = 0; s < CGIA_SPRITES; s++) {
+                const uintptr_t dsc = cache + sprite_dsc_offsets[p][s];
+                _cgia_read_range(dsc, dsc + sizeof(struct cgia_sprite_t) - 1);
+            }
+        }
+    }
+}
+
+static void _cgia_track_begin(void) {
+    memset(_cgia_read_pages, 0, sizeof(_cgia_read_pages));
+    _cgia_tracking = true;
+    _cgia_read_planes();
+    _cgia_scan_open();
+}
+
+static void _cgia_track_end(uint32_t* pages) {
+    _cgia_scan_close();
+    _cgia_read_planes();
+    _cgia_tracking = false;
+    memcpy(pages, _cgia_read_pages, sizeof(_cgia_read_pages));
+}
+
 void interp_save(interp_hw_t* interp, interp_hw_save_t* saver) {
     saver->accum[0] = interp->accum[0];
     saver->accum[1] = interp->accum[1];
@@ -197,6 +529,7 @@ void interp_save(interp_hw_t* interp, interp_hw_save_t* saver) {
 }
 
 void interp_restore(interp_hw_t* interp, interp_hw_save_t* saver) {
+    _cgia_scan_close();
     interp->accum[0] = saver->accum[0];
     interp->accum[1] = saver->accum[1];
     interp->base[0] = saver->base[0];
@@ -206,6 +539,7 @@ void interp_restore(interp_hw_t* interp, interp_hw_save_t* saver) {
     interp->shift[1] = saver->shift[1];
     interp->mask[0] = saver->mask[0];
     interp->mask[1] = saver->mask[1];
+    _cgia_scan_open();
 }
 
 static inline uintptr_t interp_get_accumulator(interp_hw_t* interp, uint lane) {
@@ -231,6 +565,12 @@ static inline uintptr_t interp_peek_lane_result(interp_hw_t* interp, uint lane)
     return interp->accum[lane] + interp->base[lane];
 }
 
+// advance the interpolators as num_pops pops would, for lines rendered without pixels
+static inline void interp_skip(interp_hw_t* interp, uint32_t num_pops) {
+    interp->accum[0] += interp->base[0] * num_pops;
+    interp->accum[1] += interp->base[1] * num_pops;
+}
+
 static inline void set_linear_scans(
     uint8_t row_height,
     const uint8_t* memory_scan,
@@ -243,14 +583,17 @@ static inline void set_linear_scans(
     assert(backgr_scan + 1 >= vram_cache[0]);
     assert((uintptr_t)backgr_scan + 1 < (uintptr_t)(vram_cache[2]));
 
+    _cgia_scan_close();
     interp0->base[0] = row_height;
     interp0->accum[0] = (uintptr_t)memory_scan;
     interp1->base[0] = 1;
     interp1->accum[0] = (uintptr_t)colour_scan;
     interp1->base[1] = 1;
     interp1->accum[1] = (uintptr_t)backgr_scan;
+    _cgia_scan_open();
 }
 static inline void set_mode7_interp_config(union cgia_plane_regs_t* plane) {
+    _cgia_scan_close();
     // interp0 will scan texture row
     // MODE7 stores texture dimensions as encoded bit counts: 0..7 means 1..8 bits,
     // yielding texture dimensions from 2 to 256 pixels.
@@ -278,6 +621,7 @@ static inline void set_mode7_scans(union cgia_plane_regs_t* plane, const uint8_t
     assert(memory_scan >= vram_cache[0]);
     assert((uintptr_t)memory_scan < (uintptr_t)(vram_cache[2]));
 
+    _cgia_scan_close();
     interp0->base[2] = (uintptr_t)memory_scan;
     const uint32_t xy = (uint32_t)interp_pop_lane_result(interp1, 2);
     // start texture columns scan
@@ -285,12 +629,14 @@ static inline void set_mode7_scans(union cgia_plane_regs_t* plane, const uint8_t
     interp0->base[0] = plane->affine.du;
     interp0->accum[1] = (xy & 0xFF00);
     interp0->base[1] = plane->affine.dv;
+    _cgia_scan_open();
 }
 
 static inline uint32_t* fill_back(uint32_t* rgbbuf, uint32_t columns, uint32_t color_idx) {
     uint pixels = columns * CGIA_COLUMN_PX;
+    if (CGIA_vpu->render_skip) return rgbbuf + pixels;
     while (pixels) {
-        *rgbbuf++ = cgia_rgb_palette[color_idx];
+        *rgbbuf++ = CGIA_PIXEL(color_idx);
         --pixels;
     }
     return rgbbuf;
@@ -308,6 +654,11 @@ uint32_t* cgia_encode_mode_0(
     uint8_t bpp,
     bool doubled,
     bool mapped) {
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns);
+        return rgbbuf + columns * (multi ? 4 : 8) * (doubled ? 2 : 1);
+    }
+    _cgia_read_range((uintptr_t)character_generator, (uintptr_t)character_generator + (255U << char_shift));
     while (columns) {
         const uintptr_t chr_addr = interp_pop_lane_result(interp0, 0);
         uint8_t chr = *((uint8_t*)chr_addr);
@@ -335,8 +686,8 @@ uint32_t* cgia_encode_mode_0(
                 if (mapped || idx) {
                     uint8_t color = shared_colors[idx & 0b00000111];
                     if (hb) color ^= 0b00000100;
-                    *rgbbuf++ = cgia_rgb_palette[color];
-                    if (doubled) *rgbbuf++ = cgia_rgb_palette[color];
+                    *rgbbuf++ = CGIA_PIXEL(color);
+                    if (doubled) *rgbbuf++ = CGIA_PIXEL(color);
                 }
                 else {
                     rgbbuf++;  // transparent pixel
@@ -358,8 +709,8 @@ uint32_t* cgia_encode_mode_0(
                         // toggle bit 2 for half-bright - move forward or backward by 4 colors
                         color ^= 0b00000100;
                     }
-                    *rgbbuf++ = cgia_rgb_palette[color];
-                    if (doubled) *rgbbuf++ = cgia_rgb_palette[color];
+                    *rgbbuf++ = CGIA_PIXEL(color);
+                    if (doubled) *rgbbuf++ = CGIA_PIXEL(color);
                 }
                 else {
                     rgbbuf++;  // transparent pixel
@@ -458,7 +809,39 @@ inline __attribute__((always_inline)) CGIA_ENCODE_MODE_0(_multi, _4bpp, _doubled
     return cgia_encode_mode_0(rgbbuf, columns, character_generator, char_shift, shared_colors, true, 4, true, true);
 }
 
-uint32_t* cgia_encode_mode_1(
+#ifdef CGIA_SIMD
+static uint32_t* _cgia_encode_mode_1_simd(
+    uint32_t* rgbbuf,
+    uint32_t columns,
+    uint8_t shared_colors[8],
+    uint8_t bpp,
+    bool doubled,
+    bool mapped) {
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns * bpp);
+        return rgbbuf + columns * 8 * (doubled ? 2 : 1);
+    }
+    // pixel of each color index, indices above 7 toggle bit 2 for half-bright
+    uint32_t lut[16];
+    for (uint i = 0; i < 16; ++i) {
+        lut[i] = CGIA_PIXEL(shared_colors[i & 0b00000111] ^ (i > 7 ? 0b00000100 : 0));
+    }
+    while (columns) {
+        uint32_t chunk = *((uint8_t*)interp_pop_lane_result(interp0, 0));
+        for (uint b = 1; b < bpp; ++b) {
+            chunk = (chunk << 8) | *((uint8_t*)interp_pop_lane_result(interp0, 0));
+        }
+        const uint32_t nibbles = _cgia_nibbles(chunk, bpp);
+        rgbbuf = _cgia_put4(rgbbuf, lut, nibbles & 0xFFFF, mapped, doubled);
+        rgbbuf = _cgia_put4(rgbbuf, lut, nibbles >> 16, mapped, doubled);
+        --columns;
+    }
+
+    return rgbbuf;
+}
+#endif
+
+static uint32_t* _cgia_encode_mode_1_scalar(
     uint32_t* rgbbuf,
     uint32_t columns,
     uint8_t shared_colors[8],
@@ -468,6 +851,10 @@ uint32_t* cgia_encode_mode_1(
     uintptr_t addr;
     uint32_t chunk;
 
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns * bpp);
+        return rgbbuf + columns * 8 * (doubled ? 2 : 1);
+    }
     while (columns) {
         addr = interp_pop_lane_result(interp0, 0);
         chunk = *((uint8_t*)addr);
@@ -496,8 +883,8 @@ uint32_t* cgia_encode_mode_1(
                     // toggle bit 2 for half-bright - move forward or backward by 4 colors
                     color ^= 0b00000100;
                 }
-                *rgbbuf++ = cgia_rgb_palette[color];
-                if (doubled) *rgbbuf++ = cgia_rgb_palette[color];
+                *rgbbuf++ = CGIA_PIXEL(color);
+                if (doubled) *rgbbuf++ = CGIA_PIXEL(color);
             }
             else {
                 rgbbuf++;  // transparent pixel
@@ -511,6 +898,21 @@ uint32_t* cgia_encode_mode_1(
     return rgbbuf;
 }
 
+uint32_t* cgia_encode_mode_1(
+    uint32_t* rgbbuf,
+    uint32_t columns,
+    uint8_t shared_colors[8],
+    uint8_t bpp,
+    bool doubled,
+    bool mapped) {
+#ifdef CGIA_SIMD
+    if (atomic_load_explicit(&_cgia_simd, memory_order_relaxed)) {
+        return _cgia_encode_mode_1_simd(rgbbuf, columns, shared_colors, bpp, doubled, mapped);
+    }
+#endif
+    return _cgia_encode_mode_1_scalar(rgbbuf, columns, shared_colors, bpp, doubled, mapped);
+}
+
 inline __attribute__((always_inline)) CGIA_ENCODE_MODE_1(_1bpp, , _shared) {
     return cgia_encode_mode_1(rgbbuf, columns, shared_colors, 1, false, false);
 }
@@ -569,6 +971,12 @@ uint32_t* cgia_encode_mode_2(
     bool multi,
     bool doubled,
     bool mapped) {
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns);
+        interp_skip(interp1, columns);
+        return rgbbuf + columns * (multi ? 4 : 8) * (doubled ? 2 : 1);
+    }
+    _cgia_read_range((uintptr_t)character_generator, (uintptr_t)character_generator + (255U << char_shift));
     while (columns) {
         uintptr_t bg_cl_addr = interp_peek_lane_result(interp1, 1);
         uint8_t bg_cl = *((uint8_t*)bg_cl_addr);
@@ -583,8 +991,8 @@ uint32_t* cgia_encode_mode_2(
                 switch (color_no) {
                     case 0b00:
                         if (mapped) {
-                            *rgbbuf++ = cgia_rgb_palette[shared_colors[0]];
-                            if (doubled) *rgbbuf++ = cgia_rgb_palette[shared_colors[0]];
+                            *rgbbuf++ = CGIA_PIXEL(shared_colors[0]);
+                            if (doubled) *rgbbuf++ = CGIA_PIXEL(shared_colors[0]);
                         }
                         else {
                             rgbbuf++;  // transparent pixel
@@ -592,16 +1000,16 @@ uint32_t* cgia_encode_mode_2(
                         }
                         break;
                     case 0b01:
-                        *rgbbuf++ = cgia_rgb_palette[bg_cl];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[bg_cl];
+                        *rgbbuf++ = CGIA_PIXEL(bg_cl);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(bg_cl);
                         break;
                     case 0b10:
-                        *rgbbuf++ = cgia_rgb_palette[fg_cl];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[fg_cl];
+                        *rgbbuf++ = CGIA_PIXEL(fg_cl);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(fg_cl);
                         break;
                     case 0b11:
-                        *rgbbuf++ = cgia_rgb_palette[shared_colors[1]];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[shared_colors[1]];
+                        *rgbbuf++ = CGIA_PIXEL(shared_colors[1]);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(shared_colors[1]);
                         break;
                     default: abort();
                 }
@@ -611,13 +1019,13 @@ uint32_t* cgia_encode_mode_2(
             for (int shift = 7; shift >= 0; shift--) {
                 uint bit_set = (bits >> shift) & 0b1;
                 if (bit_set) {
-                    *rgbbuf++ = cgia_rgb_palette[fg_cl];
-                    if (doubled) *rgbbuf++ = cgia_rgb_palette[fg_cl];
+                    *rgbbuf++ = CGIA_PIXEL(fg_cl);
+                    if (doubled) *rgbbuf++ = CGIA_PIXEL(fg_cl);
                 }
                 else {
                     if (mapped) {
-                        *rgbbuf++ = cgia_rgb_palette[bg_cl];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[bg_cl];
+                        *rgbbuf++ = CGIA_PIXEL(bg_cl);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(bg_cl);
                     }
                     else {
                         rgbbuf++;  // transparent pixel
@@ -657,13 +1065,63 @@ inline __attribute__((always_inline)) CGIA_ENCODE_MODE_2(_multi, _doubled, _mapp
     return cgia_encode_mode_2(rgbbuf, columns, character_generator, char_shift, shared_colors, true, true, true);
 }
 
-uint32_t* cgia_encode_mode_3(
+#ifdef CGIA_SIMD
+static uint32_t* _cgia_encode_mode_3_simd(
+    uint32_t* rgbbuf,
+    uint32_t columns,
+    uint8_t shared_colors[8],
+    bool multi,
+    bool doubled,
+    bool mapped) {
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns);
+        interp_skip(interp1, columns);
+        return rgbbuf + columns * (multi ? 4 : 8) * (doubled ? 2 : 1);
+    }
+    // pixel of each color number, background and foreground change every column
+    uint32_t lut[16] = { 0 };
+    if (multi) {
+        lut[0b00] = CGIA_PIXEL(shared_colors[0]);
+        lut[0b11] = CGIA_PIXEL(shared_colors[1]);
+    }
+    while (columns) {
+        uintptr_t bg_cl_addr = interp_peek_lane_result(interp1, 1);
+        uint8_t bg_cl = *((uint8_t*)bg_cl_addr);
+        uintptr_t fg_cl_addr = interp_pop_lane_result(interp1, 0);
+        uint8_t fg_cl = *((uint8_t*)fg_cl_addr);
+        uintptr_t bits_addr = interp_pop_lane_result(interp0, 0);
+        uint8_t bits = *((uint8_t*)bits_addr);
+        if (multi) {
+            lut[0b01] = CGIA_PIXEL(bg_cl);
+            lut[0b10] = CGIA_PIXEL(fg_cl);
+            rgbbuf = _cgia_put4(rgbbuf, lut, _cgia_nibbles_2bpp[bits], mapped, doubled);
+        }
+        else {
+            lut[0] = CGIA_PIXEL(bg_cl);
+            lut[1] = CGIA_PIXEL(fg_cl);
+            const uint32_t nibbles = _cgia_nibbles_1bpp[bits];
+            rgbbuf = _cgia_put4(rgbbuf, lut, nibbles & 0xFFFF, mapped, doubled);
+            rgbbuf = _cgia_put4(rgbbuf, lut, nibbles >> 16, mapped, doubled);
+        }
+        --columns;
+    }
+
+    return rgbbuf;
+}
+#endif
+
+static uint32_t* _cgia_encode_mode_3_scalar(
     uint32_t* rgbbuf,
     uint32_t columns,
     uint8_t shared_colors[8],
     bool multi,
     bool doubled,
     bool mapped) {
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns);
+        interp_skip(interp1, columns);
+        return rgbbuf + columns * (multi ? 4 : 8) * (doubled ? 2 : 1);
+    }
     while (columns) {
         uintptr_t bg_cl_addr = interp_peek_lane_result(interp1, 1);
         uint8_t bg_cl = *((uint8_t*)bg_cl_addr);
@@ -677,8 +1135,8 @@ uint32_t* cgia_encode_mode_3(
                 switch (color_no) {
                     case 0b00:
                         if (mapped) {
-                            *rgbbuf++ = cgia_rgb_palette[shared_colors[0]];
-                            if (doubled) *rgbbuf++ = cgia_rgb_palette[shared_colors[0]];
+                            *rgbbuf++ = CGIA_PIXEL(shared_colors[0]);
+                            if (doubled) *rgbbuf++ = CGIA_PIXEL(shared_colors[0]);
                         }
                         else {
                             rgbbuf++;  // transparent pixel
@@ -686,16 +1144,16 @@ uint32_t* cgia_encode_mode_3(
                         }
                         break;
                     case 0b01:
-                        *rgbbuf++ = cgia_rgb_palette[bg_cl];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[bg_cl];
+                        *rgbbuf++ = CGIA_PIXEL(bg_cl);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(bg_cl);
                         break;
                     case 0b10:
-                        *rgbbuf++ = cgia_rgb_palette[fg_cl];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[fg_cl];
+                        *rgbbuf++ = CGIA_PIXEL(fg_cl);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(fg_cl);
                         break;
                     case 0b11:
-                        *rgbbuf++ = cgia_rgb_palette[shared_colors[1]];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[shared_colors[1]];
+                        *rgbbuf++ = CGIA_PIXEL(shared_colors[1]);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(shared_colors[1]);
                         break;
                     default: abort();
                 }
@@ -705,13 +1163,13 @@ uint32_t* cgia_encode_mode_3(
             for (int shift = 7; shift >= 0; shift--) {
                 uint bit_set = (bits >> shift) & 0b1;
                 if (bit_set) {
-                    *rgbbuf++ = cgia_rgb_palette[fg_cl];
-                    if (doubled) *rgbbuf++ = cgia_rgb_palette[fg_cl];
+                    *rgbbuf++ = CGIA_PIXEL(fg_cl);
+                    if (doubled) *rgbbuf++ = CGIA_PIXEL(fg_cl);
                 }
                 else {
                     if (mapped) {
-                        *rgbbuf++ = cgia_rgb_palette[bg_cl];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[bg_cl];
+                        *rgbbuf++ = CGIA_PIXEL(bg_cl);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(bg_cl);
                     }
                     else {
                         rgbbuf++;  // transparent pixel
@@ -726,6 +1184,21 @@ uint32_t* cgia_encode_mode_3(
     return rgbbuf;
 }
 
+uint32_t* cgia_encode_mode_3(
+    uint32_t* rgbbuf,
+    uint32_t columns,
+    uint8_t shared_colors[8],
+    bool multi,
+    bool doubled,
+    bool mapped) {
+#ifdef CGIA_SIMD
+    if (atomic_load_explicit(&_cgia_simd, memory_order_relaxed)) {
+        return _cgia_encode_mode_3_simd(rgbbuf, columns, shared_colors, multi, doubled, mapped);
+    }
+#endif
+    return _cgia_encode_mode_3_scalar(rgbbuf, columns, shared_colors, multi, doubled, mapped);
+}
+
 inline __attribute__((always_inline)) CGIA_ENCODE_MODE_3(, , _shared) {
     return cgia_encode_mode_3(rgbbuf, columns, shared_colors, false, false, false);
 }
@@ -829,6 +1302,10 @@ cgia_encode_mode_6_common(uint32_t* rgbbuf, uint32_t columns, uint8_t base_color
     uintptr_t addr;
     uint8_t byte0, byte1, byte2, cmd;
 
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns * 3);
+        return rgbbuf + columns * 4 * (doubled ? 2 : 1);
+    }
     while (columns) {
         addr = interp_pop_lane_result(interp0, 0);
         byte0 = *((uint8_t*)addr);
@@ -840,26 +1317,26 @@ cgia_encode_mode_6_common(uint32_t* rgbbuf, uint32_t columns, uint8_t base_color
         // extract first command
         cmd = (byte0 >> 2);
         current_color = cgia_encode_mode_6_command(cmd, current_color, base_color);
-        *rgbbuf++ = current_color;
-        if (doubled) *rgbbuf++ = current_color;
+        *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
+        if (doubled) *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
 
         // extract second command
         cmd = ((byte0 << 4) & 0x30) | (byte1 >> 4);
         current_color = cgia_encode_mode_6_command(cmd, current_color, base_color);
-        *rgbbuf++ = current_color;
-        if (doubled) *rgbbuf++ = current_color;
+        *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
+        if (doubled) *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
 
         // extract third command
         cmd = ((byte1 << 2) & 0x3C) | (byte2 >> 6);
         current_color = cgia_encode_mode_6_command(cmd, current_color, base_color);
-        *rgbbuf++ = current_color;
-        if (doubled) *rgbbuf++ = current_color;
+        *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
+        if (doubled) *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
 
         // extract fourth command
         cmd = (byte2 & 0x3F);
         current_color = cgia_encode_mode_6_command(cmd, current_color, base_color);
-        *rgbbuf++ = current_color;
-        if (doubled) *rgbbuf++ = current_color;
+        *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
+        if (doubled) *rgbbuf++ = CGIA_RGB_PIXEL(current_color);
 
         --columns;
     }
@@ -877,13 +1354,55 @@ cgia_encode_mode_6_doubled(uint32_t* rgbbuf, uint32_t columns, uint8_t base_colo
     return cgia_encode_mode_6_common(rgbbuf, columns, base_color, back_color, true);
 }
 
-uint32_t* cgia_encode_mode_7(uint32_t* rgbbuf, uint32_t columns) {
+#ifdef CGIA_SIMD
+static uint32_t* _cgia_encode_mode_7_simd(uint32_t* rgbbuf, uint32_t columns) {
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns * 8);
+        return rgbbuf + columns * 8;
+    }
+    // lane 2 results of 4 pops at once, the accumulators advance by their base every pop
+    interp_hw_t* interp = interp0;
+    const uint8_t* texture = (const uint8_t*)interp->base[2];
+    const uint32_t du = (uint32_t)interp->base[0];
+    const uint32_t dv = (uint32_t)interp->base[1];
+    const cgia_v4_t step0 = _cgia_v4_set(0, du, 2 * du, 3 * du);
+    const cgia_v4_t step1 = _cgia_v4_set(0, dv, 2 * dv, 3 * dv);
+    const cgia_v4_t mask0 = _cgia_v4_dup(interp->mask[0]);
+    const cgia_v4_t mask1 = _cgia_v4_dup(interp->mask[1]);
+    while (columns) {
+        for (int p = 0; p < 8; p += 4) {
+            const cgia_v4_t accum0 = _cgia_v4_add(_cgia_v4_dup((uint32_t)interp->accum[0]), step0);
+            const cgia_v4_t accum1 = _cgia_v4_add(_cgia_v4_dup((uint32_t)interp->accum[1]), step1);
+            const cgia_v4_t lane0 = _cgia_v4_and(_cgia_v4_shr(accum0, interp->shift[0]), mask0);
+            const cgia_v4_t lane1 = _cgia_v4_and(_cgia_v4_shr(accum1, interp->shift[1]), mask1);
+            uint32_t offset[4];
+            _cgia_v4_store(offset, _cgia_v4_add(lane0, lane1));
+            for (int i = 0; i < 4; ++i) {
+                assert((uintptr_t)(texture + offset[i]) >= (uintptr_t)vram_cache[0]);
+                assert((uintptr_t)(texture + offset[i]) < (uintptr_t)vram_cache[2]);
+            }
+            interp->accum[0] += interp->base[0] * 4;
+            interp->accum[1] += interp->base[1] * 4;
+            rgbbuf = _cgia_put_texels4(rgbbuf, texture, offset);
+        }
+        --columns;
+    }
+
+    return rgbbuf;
+}
+#endif
+
+static uint32_t* _cgia_encode_mode_7_scalar(uint32_t* rgbbuf, uint32_t columns) {
+    if (CGIA_vpu->render_skip) {
+        interp_skip(interp0, columns * 8);
+        return rgbbuf + columns * 8;
+    }
     while (columns) {
         for (int p = 0; p < 8; ++p) {
             uintptr_t cl_addr = interp_pop_lane_result(interp0, 2);
             assert(cl_addr >= (uintptr_t)vram_cache[0]);
             assert(cl_addr < (uintptr_t)vram_cache[2]);
-            *rgbbuf++ = cgia_rgb_palette[*((uint8_t*)cl_addr)];
+            *rgbbuf++ = CGIA_PIXEL(*((uint8_t*)cl_addr));
         }
         --columns;
     }
@@ -891,6 +1410,15 @@ uint32_t* cgia_encode_mode_7(uint32_t* rgbbuf, uint32_t columns) {
     return rgbbuf;
 }
 
+uint32_t* cgia_encode_mode_7(uint32_t* rgbbuf, uint32_t columns) {
+#ifdef CGIA_SIMD
+    if (atomic_load_explicit(&_cgia_simd, memory_order_relaxed)) {
+        return _cgia_encode_mode_7_simd(rgbbuf, columns);
+    }
+#endif
+    return _cgia_encode_mode_7_scalar(rgbbuf, columns);
+}
+
 uint32_t* cgia_encode_vt(uint32_t* rgbbuf, uint32_t columns, const uint8_t* character_generator, uint32_t char_shift) {
     abort();
 }
@@ -903,6 +1431,10 @@ void cgia_encode_sprite_both(
     bool mirror) {
     struct cgia_sprite_t* dsc = (struct cgia_sprite_t*)descriptor;
 
+    if (CGIA_vpu->render_skip) return;
+    // mirrored sprites walk the line data backwards
+    _cgia_read_range((uintptr_t)descriptor, (uintptr_t)descriptor + sizeof(struct cgia_sprite_t) - 1);
+    _cgia_read_range((uintptr_t)line_data - width - 1, (uintptr_t)line_data + width + 1);
     if (dsc->pos_x > CGIA_ACTIVE_WIDTH || dsc->pos_x < -SPRITE_MAX_WIDTH * 8 * 2) return;
 
     rgbbuf += dsc->pos_x;  // move RGB buffer pointer to correct position in line
@@ -930,16 +1462,16 @@ void cgia_encode_sprite_both(
                         if (doubled) rgbbuf++;
                         break;
                     case 0b01:
-                        *rgbbuf++ = cgia_rgb_palette[dsc->color[0]];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[dsc->color[0]];
+                        *rgbbuf++ = CGIA_PIXEL(dsc->color[0]);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(dsc->color[0]);
                         break;
                     case 0b10:
-                        *rgbbuf++ = cgia_rgb_palette[dsc->color[1]];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[dsc->color[1]];
+                        *rgbbuf++ = CGIA_PIXEL(dsc->color[1]);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(dsc->color[1]);
                         break;
                     case 0b11:
-                        *rgbbuf++ = cgia_rgb_palette[dsc->color[2]];
-                        if (doubled) *rgbbuf++ = cgia_rgb_palette[dsc->color[2]];
+                        *rgbbuf++ = CGIA_PIXEL(dsc->color[2]);
+                        if (doubled) *rgbbuf++ = CGIA_PIXEL(dsc->color[2]);
                         break;
                     default: abort();
                 }
@@ -964,8 +1496,8 @@ void cgia_encode_sprite_both(
             for (int shift = shift_start; shift != shift_target; shift += shift_delta) {
                 uint bit_set = (*line_data >> shift) & 0b1;
                 if (bit_set) {
-                    *rgbbuf++ = cgia_rgb_palette[dsc->color[0]];
-                    if (doubled) *rgbbuf++ = cgia_rgb_palette[dsc->color[0]];
+                    *rgbbuf++ = CGIA_PIXEL(dsc->color[0]);
+                    if (doubled) *rgbbuf++ = CGIA_PIXEL(dsc->color[0]);
                 }
                 else {
                     rgbbuf++;  // transparent pixel
@@ -994,28 +1526,189 @@ void cgia_encode_sprite_mirror(uint32_t* rgbbuf, const uint32_t* descriptor, con
 #undef cgia_init
 #undef cgia_reset
 
-static bool vcache_dma_running = false;
-static uint32_t vcache_dma_src_addr24 = 0;
+// run-ahead journal of the VRAM cache, between cgia_fw_state_save() and
+// cgia_fw_state_load() the 256 byte pages are saved before their first write
+typedef struct {
+    uint32_t page_saved[CGIA_VRAM_CACHE_PAGES / 32];
+    uint32_t num_pages;
+    uint16_t page[CGIA_VRAM_CACHE_PAGES];
+    uint8_t page_data[CGIA_VRAM_CACHE_PAGES][256];
+} _cgia_vram_journal_t;
+
+static _cgia_vram_journal_t* _cgia_journal;
+
+// a VRAM cache page is about to change
+static inline void _cgia_vram_write(cgia_t* vpu, const uint8_t* ptr) {
+    const uint32_t page = _cgia_vram_page(ptr);
+    vpu->vram_page_gen[page]++;
+    if (_cgia_journal) {
+        if (0 == (_cgia_journal->page_saved[page >> 5] & (1U << (page & 31)))) {
+            _cgia_journal->page_saved[page >> 5] |= 1U << (page & 31);
+            _cgia_journal->page[_cgia_journal->num_pages] = (uint16_t)page;
+            memcpy(_cgia_journal->page_data[_cgia_journal->num_pages++], (const uint8_t*)vram_cache + (page << 8), 256);
+        }
+    }
+}
+
 static void _vcache_dma_process_block(cgia_t* vpu) {
     if (vcache_dma_blocks_remaining > 0) {
-        if (!vcache_dma_running) {
+        if (!vpu->vcache_dma_running) {
             LOG_INFO("Starting RAM to VCACHE DMA transfer for bank %u", vcache_dma_bank);
-            vcache_dma_src_addr24 = vcache_dma_bank << 16;
-            vcache_dma_running = true;
+            vpu->vcache_dma_src_addr24 = vcache_dma_bank << 16;
+            vpu->vcache_dma_running = true;
         }
         else {
+            // a block spans at most two pages
+            _cgia_vram_write(vpu, vcache_dma_dest);
+            if (_cgia_vram_page(vcache_dma_dest + 31) != _cgia_vram_page(vcache_dma_dest)) {
+                _cgia_vram_write(vpu, vcache_dma_dest + 31);
+            }
             for (size_t i = 0; i < 32; ++i) {
-                *(vcache_dma_dest++) = vpu->fetch_cb(vcache_dma_src_addr24++, vpu->user_data);
+                *(vcache_dma_dest++) = vpu->fetch_cb(vpu->vcache_dma_src_addr24++, vpu->user_data);
             }
             --vcache_dma_blocks_remaining;
             if (vcache_dma_blocks_remaining == 0) {
-                vcache_dma_running = false;
+                vpu->vcache_dma_running = false;
                 LOG_INFO("Complete RAM to VCACHE DMA transfer for bank %u", vcache_dma_bank);
             }
         }
     }
 }
 
+bool cgia_set_simd(bool enabled) {
+#ifdef CGIA_SIMD
+    atomic_store_explicit(&_cgia_simd, enabled, memory_order_relaxed);
+    return true;
+#else
+    (void)enabled;
+    return false;
+#endif
+}
+
+uint32_t cgia_idle_ticks(const cgia_t* vpu) {
+    if (vcache_dma_blocks_remaining > 0) {
+        // DMA transfers a block in each tick
+        return 0;
+    }
+    return (vpu->h_period - vpu->h_count - 1) / CGIA_FIXEDPOINT_SCALE;
+}
+
+void cgia_skip_ticks(cgia_t* vpu, uint32_t num_ticks) {
+    CHIPS_ASSERT(num_ticks <= cgia_idle_ticks(vpu));
+    vpu->h_count += num_ticks * CGIA_FIXEDPOINT_SCALE;
+}
+
+// firmware globals making up the renderer state besides the VRAM cache, VRAM
+// cache pointers stay valid as they point into the (process-wide) VRAM cache itself
+#define _CGIA_FW_STATE(X) \
+    X(CGIA)                \
+    X(plane_int)           \
+    X(sprite_dsc_offsets)  \
+    X(int_mask)            \
+    X(vram_cache_bank)     \
+    X(vram_wanted_bank)    \
+    X(vram_cache_ptr)      \
+    X(vcache_dma_bank)     \
+    X(vcache_dma_dest)     \
+    X(vcache_dma_blocks_remaining)
+
+size_t cgia_fw_state_size(void) {
+#define _CGIA_FW_SIZE(v) +sizeof(v)
+    return sizeof(_cgia_vram_journal_t) _CGIA_FW_STATE(_CGIA_FW_SIZE);
+#undef _CGIA_FW_SIZE
+}
+
+void cgia_fw_state_save(uint8_t* dst) {
+    CHIPS_ASSERT(dst);
+    // the journal comes first, to keep it aligned
+    _cgia_journal = (_cgia_vram_journal_t*)dst;
+    memset(_cgia_journal->page_saved, 0, sizeof(_cgia_journal->page_saved));
+    _cgia_journal->num_pages = 0;
+    dst += sizeof(_cgia_vram_journal_t);
+#define _CGIA_FW_SAVE(v)                      \
+    memcpy(dst, (const void*)&(v), sizeof(v)); \
+    dst += sizeof(v);
+    _CGIA_FW_STATE(_CGIA_FW_SAVE)
+#undef _CGIA_FW_SAVE
+}
+
+void cgia_fw_state_load(const uint8_t* src) {
+    CHIPS_ASSERT(src && (_cgia_journal == (const _cgia_vram_journal_t*)src));
+    for (uint32_t i = 0; i < _cgia_journal->num_pages; i++) {
+        memcpy((uint8_t*)vram_cache + ((uint32_t)_cgia_journal->page[i] << 8), _cgia_journal->page_data[i], 256);
+    }
+    _cgia_journal = NULL;
+    src += sizeof(_cgia_vram_journal_t);
+#define _CGIA_FW_LOAD(v)                \
+    memcpy((void*)&(v), src, sizeof(v)); \
+    src += sizeof(v);
+    _CGIA_FW_STATE(_CGIA_FW_LOAD)
+#undef _CGIA_FW_LOAD
+}
+
+void cgia_mem_write(cgia_t* vpu, uint8_t bank, uint16_t addr, uint8_t data) {
+    for (int i = 0; i < CGIA_VRAM_BANKS; ++i) {
+        if ((vram_cache_bank[i] == bank) && (vram_cache_ptr[i][addr] != data)) {
+            _cgia_vram_write(vpu, &vram_cache_ptr[i][addr]);
+        }
+    }
+    cgia_ram_write(bank, addr, data);
+}
+
+// firmware globals a rasterized line depends on, besides the VRAM cache contents
+#define _CGIA_LINE_INPUTS(X) \
+    X(CGIA)                  \
+    X(plane_int)             \
+    X(sprite_dsc_offsets)    \
+    X(vram_cache_bank)       \
+    X(vram_cache_ptr)
+
+static inline uint64_t _cgia_mix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 29);
+}
+
+static uint64_t _cgia_hash(uint64_t hash, const void* data, size_t size) {
+    // 64 bit words, the tail padded with zeros
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t word;
+    for (; size >= sizeof(word); size -= sizeof(word), p += sizeof(word)) {
+        memcpy(&word, p, sizeof(word));
+        hash = _cgia_mix(hash, word);
+    }
+    if (size > 0) {
+        word = 0;
+        memcpy(&word, p, size);
+        hash = _cgia_mix(hash, word);
+    }
+    return hash;
+}
+
+// the renderer state at the start of a line
+static uint64_t _cgia_line_inputs(uint16_t line) {
+    uint64_t hash = _cgia_mix(0xCBF29CE484222325ULL, line);
+#define _CGIA_LINE_HASH(v) hash = _cgia_hash(hash, (const void*)&(v), sizeof(v));
+    _CGIA_LINE_INPUTS(_CGIA_LINE_HASH)
+#undef _CGIA_LINE_HASH
+    return hash;
+}
+
+// the line inputs and the generations of the VRAM cache pages the line reads,
+// writes to other pages leave the signature alone
+static uint64_t _cgia_line_signature(const cgia_t* vpu, uint64_t inputs, const uint32_t* pages) {
+    uint64_t hash = inputs;
+    for (uint32_t i = 0; i < CGIA_VRAM_CACHE_PAGES / 32; i++) {
+        if (pages[i] == 0) continue;
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            if (pages[i] & (1U << bit)) {
+                const uint32_t page = (i << 5) | bit;
+                hash = _cgia_mix(hash, ((uint64_t)page << 32) | vpu->vram_page_gen[page]);
+            }
+        }
+    }
+    return hash;
+}
+
 static void _copy_internal_regs(cgia_t* vpu) {
     vpu->chip = (uint8_t*)&CGIA;
     for (int i = 0; i < CGIA_PLANES; ++i) {
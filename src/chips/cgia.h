@@ -141,14 +141,34 @@ extern "C" {
 // hardware color palette
 #define CGIA_HWCOLOR_NUM (CGIA_COLORS_NUM)
 
+// pixel repetition in the framebuffer, with CGIA_NATIVE_FB the framebuffer
+// holds the rasterized pixels only and the display does the scale-up
+#ifdef CGIA_NATIVE_FB
+#define CGIA_FB_H_REPEAT (1)
+#define CGIA_FB_V_REPEAT (1)
+#else
+#define CGIA_FB_H_REPEAT (FB_H_REPEAT)
+#define CGIA_FB_V_REPEAT (FB_V_REPEAT)
+#endif
+
 // framebuffer width and height
-#define CGIA_FRAMEBUFFER_WIDTH      (MODE_H_ACTIVE_PIXELS)
-#define CGIA_FRAMEBUFFER_HEIGHT     (MODE_V_ACTIVE_LINES)
-#define CGIA_FRAMEBUFFER_SIZE_BYTES (CGIA_FRAMEBUFFER_WIDTH * CGIA_FRAMEBUFFER_HEIGHT * 4)
+#define CGIA_FRAMEBUFFER_WIDTH      (CGIA_ACTIVE_WIDTH * CGIA_FB_H_REPEAT)
+#define CGIA_FRAMEBUFFER_HEIGHT     (CGIA_ACTIVE_HEIGHT * CGIA_FB_V_REPEAT)
+#define CGIA_FRAMEBUFFER_SIZE_BYTES (CGIA_FRAMEBUFFER_WIDTH * CGIA_FRAMEBUFFER_HEIGHT * CGIA_FB_BYTES_PER_PIXEL)
+
+// framebuffer pixels, with CGIA_INDEXED_FB these are hardware color indices
+// and the display expands them through the palette
+#ifdef CGIA_INDEXED_FB
+#define CGIA_FB_BYTES_PER_PIXEL (1)
+typedef uint8_t cgia_pixel_t;
+#else
+#define CGIA_FB_BYTES_PER_PIXEL (4)
+typedef uint32_t cgia_pixel_t;
+#endif
 
 // linebuffer used to rasterize a line
 #define CGIA_LINEBUFFER_PADDING (-SCHAR_MIN)  // maximum scroll of signed 8 bit
-#define CGIA_LINEBUFFER_WIDTH   (CGIA_FRAMEBUFFER_WIDTH / FB_H_REPEAT + 2 * CGIA_LINEBUFFER_PADDING)
+#define CGIA_LINEBUFFER_WIDTH   (CGIA_ACTIVE_WIDTH + 2 * CGIA_LINEBUFFER_PADDING)
 
 // pixel width and height of entire visible area
 #define CGIA_DISPLAY_WIDTH  (MODE_H_ACTIVE_PIXELS)
@@ -161,6 +181,23 @@ extern "C" {
 // fixed point precision for more precise error accumulation
 #define CGIA_FIXEDPOINT_SCALE (256)
 
+// framebuffer rows written since the range was last reset, none if top >= bottom
+typedef struct {
+    uint16_t top, bottom;
+} cgia_dirty_t;
+
+#define CGIA_DIRTY_NONE ((cgia_dirty_t){ CGIA_FRAMEBUFFER_HEIGHT, 0 })
+#define CGIA_DIRTY_ALL  ((cgia_dirty_t){ 0, CGIA_FRAMEBUFFER_HEIGHT })
+
+// 256 byte pages of the two 64 KB VRAM cache banks
+#define CGIA_VRAM_CACHE_PAGES (2 * 256)
+
+// signature of a rasterized line, with the VRAM cache pages read to rasterize it
+typedef struct {
+    uint64_t sig;
+    uint32_t pages[CGIA_VRAM_CACHE_PAGES / 32];
+} cgia_line_sig_t;
+
 // a memory-fetch callback, used to read video memory bytes into the CGIA
 typedef uint8_t (*cgia_fetch_t)(uint32_t data, void* user_data);
 
@@ -173,12 +210,24 @@ typedef struct {
     int tick_hz;
     // pointer to an uint8_t framebuffer where video image is written to (must be at least 512*244 bytes)
     chips_range_t framebuffer;
+    // optional signature of each rasterized line, kept along the framebuffer (CGIA_ACTIVE_HEIGHT cgia_line_sig_t items)
+    chips_range_t line_sig;
+    // optional range of written framebuffer rows, kept along the framebuffer
+    cgia_dirty_t* dirty;
     // memory-fetch callback
     cgia_fetch_t fetch_cb;
     // optional user-data for the fetch callback
     void* user_data;
 } cgia_desc_t;
 
+// state of an RP2040 hardware interpolator, used by the firmware renderer
+typedef struct {
+    uintptr_t accum[2];
+    uintptr_t base[3];
+    uint8_t shift[2];
+    uint32_t mask[2];
+} cgia_interp_t;
+
 // the cgia state struct
 typedef struct {
     // last pin state
@@ -220,8 +269,23 @@ typedef struct {
     cgia_fetch_t fetch_cb;
     // optional user-data for the fetch-callback
     void* user_data;
-    // pointer to uint8_t buffer where decoded video image is written too
-    uint32_t* fb;
+    // pointer to buffer where decoded video image is written too
+    cgia_pixel_t* fb;
+    // leave the framebuffer untouched, lines are not rasterized
+    bool fb_skip;
+    // frames skipped between rasterized frames, scan state, raster and NMI timing stay exact
+    uint8_t frame_skip;
+    uint8_t frame_skip_count;
+    bool frame_skipped;
+    // the current line is rendered without generating pixels
+    bool render_skip;
+    // signature of the inputs of each line in the framebuffer, lines with
+    // unchanged inputs are not rasterized again
+    cgia_line_sig_t* line_sig;
+    // bumped by every change to the contents of a VRAM cache page
+    uint32_t vram_page_gen[CGIA_VRAM_CACHE_PAGES];
+    // framebuffer rows written, reset by the consumer of the framebuffer
+    cgia_dirty_t* dirty;
     // hardware colors
     uint32_t* hwcolors;
     // VRAM banks
@@ -229,18 +293,43 @@ typedef struct {
     // rasterizer linebuffer
     uint32_t linebuffer[2][CGIA_LINEBUFFER_WIDTH];
     uint8_t linebuffer_idx;
+    // rasterizer interpolators
+    cgia_interp_t interp[2];
+    // NMIB output of the firmware, active HIGH
+    bool nmi;
+    // RAM to VCACHE DMA transfer in progress
+    bool vcache_dma_running;
+    uint32_t vcache_dma_src_addr24;
 } cgia_t;
 
 // initialize a new cgia_t instance
 void cgia_init(cgia_t* vpu, const cgia_desc_t* desc);
 // reset a cgia_t instance
 void cgia_reset(cgia_t* vpu);
+// mirror a RAM write into the VRAM cache
+void cgia_mem_write(cgia_t* vpu, uint8_t bank, uint16_t addr, uint8_t data);
 // tick the cgia_t instance, this will call the fetch_cb and generate the image
 uint64_t cgia_tick(cgia_t* vpu, uint64_t pins);
+// number of upcoming ticks without chip-select before the next scanline or VCACHE DMA transfer
+uint32_t cgia_idle_ticks(const cgia_t* vpu);
+// advance the horizontal counter by up to cgia_idle_ticks() ticks without chip-select
+void cgia_skip_ticks(cgia_t* vpu, uint32_t num_ticks);
+// select the vectorized or the scalar reference bitmap and affine encoders for
+// all instances, returns false if the build has no vectorized encoders
+bool cgia_set_simd(bool enabled);
 // prepare cgia_t snapshot for saving
 void cgia_snapshot_onsave(cgia_t* snapshot);
 // fixup cgia_t snapshot after loading
 void cgia_snapshot_onload(cgia_t* snapshot, cgia_t* sys);
+// size of the renderer state kept in firmware globals (registers, scan state) and of
+// the journal of the VRAM cache
+size_t cgia_fw_state_size(void);
+// copy the firmware renderer state out of the firmware globals, VRAM cache pages
+// are journaled on their first write until the matching cgia_fw_state_load()
+void cgia_fw_state_save(uint8_t* dst);
+// copy the firmware renderer state back into the firmware globals, restore the
+// journaled VRAM cache pages and stop journaling
+void cgia_fw_state_load(const uint8_t* src);
 // read CGIA register value
 uint8_t cgia_reg_read(uint8_t reg_no);
 // write CGIA register
@@ -52,6 +52,10 @@ typedef struct {
     chips_rect_t screen;
     chips_range_t palette;
     bool portrait;
+    struct {
+        bool valid;             // if not valid, all framebuffer rows may have changed
+        int top, bottom;        // changed framebuffer rows, none if top >= bottom
+    } dirty;
 } chips_display_info_t;
 
 typedef struct {
@@ -0,0 +1,8 @@
+/*
+    Implementation of the header-only chips used by the x65 library.
+*/
+#define CHIPS_IMPL
+#include "chips/chips_common.h"
+#include "chips/w65c816s.h"
+#include "chips/clk.h"
+#include "chips/beeper.h"
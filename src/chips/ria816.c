@@ -14,6 +14,8 @@
     #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+static_assert(RIA816_XSTACK_SIZE == XSTACK_SIZE, "RIA816_XSTACK_SIZE must match the firmware");
+
 // fixed point precision for more precise error accumulation
 #define RIA816_FIXEDPOINT_SCALE (256)
 
@@ -54,6 +56,15 @@ static uint64_t _ria816_tick(ria816_t* c, uint64_t pins) {
     return pins;
 }
 
+uint32_t ria816_idle_ticks(const ria816_t* c) {
+    return (uint32_t)(c->ticks_per_ms - c->ticks_counter - 1) / RIA816_FIXEDPOINT_SCALE;
+}
+
+void ria816_skip_ticks(ria816_t* c, uint32_t num_ticks) {
+    CHIPS_ASSERT(num_ticks <= ria816_idle_ticks(c));
+    c->ticks_counter += (int)num_ticks * RIA816_FIXEDPOINT_SCALE;
+}
+
 uint8_t ria816_uart_status(const ria816_t* c) {
     uint8_t data = 0;
     if (rb_is_empty(&c->uart_rx))
@@ -110,8 +121,8 @@ uint8_t ria816_reg_read(ria816_t* c, uint8_t addr) {
         case RIA816_IRQ_STATUS: data = ~(c->int_status); break;
 
         case RIA816_API_STACK:
-            data = xstack[xstack_ptr];
-            if (xstack_ptr < XSTACK_SIZE) ++xstack_ptr;
+            data = c->xstack[c->xstack_ptr];
+            if (c->xstack_ptr < RIA816_XSTACK_SIZE) ++c->xstack_ptr;
             break;
 
         default: data = c->reg[addr];
@@ -127,7 +138,7 @@ void ria816_reg_write(ria816_t* c, uint8_t addr, uint8_t data) {
         case RIA816_IRQ_ENABLE: c->irq_enable = (data && 0x01); break;
 
         case RIA816_API_STACK:
-            if (xstack_ptr) xstack[--xstack_ptr] = data;
+            if (c->xstack_ptr) c->xstack[--c->xstack_ptr] = data;
             break;
         case RIA816_API_OP_RET:
             if (c->api_cb) c->api_cb(data, c->user_data);
@@ -148,8 +159,6 @@ static uint64_t _ria816_update_irq(ria816_t* c, uint64_t pins) {
 
 #include "sys/ria.h"
 
-static uint8_t HID_dev = 0;
-
 #ifdef NDEBUG
 static inline void DBG(const char* fmt, ...) {
     (void)fmt;
@@ -163,7 +172,9 @@ typedef uint32_t DWORD;
 #include "hid/kbd.c"
 #include "hid/mou.c"
 #include "hid/pad.c"
-#include <SDL3/SDL.h>
+#ifdef USE_SDL
+    #include <SDL3/SDL.h>
+#endif
 
 static void pad_synth_report(pad_connection_t* conn, void* data, uint16_t event_type, pad_xram_t* report) {
     DBG("Type: 0x%X - %p, slot: %d", event_type, data, conn->slot);
@@ -172,6 +183,7 @@ static void pad_synth_report(pad_connection_t* conn, void* data, uint16_t event_
     uint8_t button0 = 0;
     uint8_t button1 = 0;
 
+#ifdef USE_SDL
     if (event_type >= SDL_EVENT_JOYSTICK_AXIS_MOTION && event_type <= SDL_EVENT_JOYSTICK_UPDATE_COMPLETE) {
         // Joystick event
 
@@ -227,12 +239,19 @@ static void pad_synth_report(pad_connection_t* conn, void* data, uint16_t event_
         if (SDL_GetGamepadButton(data, SDL_GAMEPAD_BUTTON_LEFT_STICK)) button1 |= (1 << 5);   // L3
         if (SDL_GetGamepadButton(data, SDL_GAMEPAD_BUTTON_RIGHT_STICK)) button1 |= (1 << 6);  // R3
     }
+#endif
 
     report->dpad |= dpad & 0x0F;  // only lower 4 bits are dpad
     report->button0 = button0;
     report->button1 = button1;
+#ifdef USE_SDL
+    const char* kind = SDL_IsGamepad(SDL_GetGamepadID(data)) ? "Gamepad" : "Joystick";
+#else
+    const char* kind = "Gamepad";
+#endif
+    (void)kind;
     DBG("\t%s: 0x%02X, Sticks: 0x%02X, Buttons: 0x%02X 0x%02X, Sticks: L(%d,%d) R(%d,%d), Triggers: L(%d) R(%d)",
-        SDL_IsGamepad(SDL_GetGamepadID(data)) ? "Gamepad" : "Joystick",
+        kind,
         report->dpad,
         report->sticks,
         report->button0,
@@ -247,32 +266,31 @@ static void pad_synth_report(pad_connection_t* conn, void* data, uint16_t event_
 
 uint8_t ria816_hid_read(ria816_t* c, uint8_t reg) {
     uint8_t data = 0xFF;  // invalid
-    switch (HID_dev & 0xF) {
-        case RIA_HID_DEV_KEYBOARD: data = kbd_get_reg((HID_dev & 0xF0) | reg); break;
+    switch (c->hid_dev & 0xF) {
+        case RIA_HID_DEV_KEYBOARD: data = kbd_get_reg((c->hid_dev & 0xF0) | reg); break;
         case RIA_HID_DEV_MOUSE: data = mou_get_reg(reg); break;
-        case RIA_HID_DEV_GAMEPAD: data = pad_get_reg(HID_dev >> 4, reg); break;
+        case RIA_HID_DEV_GAMEPAD: data = pad_get_reg(c->hid_dev >> 4, reg); break;
     }
     return data;
 }
 void ria816_hid_write(ria816_t* c, uint8_t reg, uint8_t data) {
     if (reg == 0x00)  // HID SELECT
-        HID_dev = data;
+        c->hid_dev = data;
 }
 
 uint8_t ria816_hid_dev(const ria816_t* c) {
-    return HID_dev;
+    return c->hid_dev;
 }
 
 #include "south/sys/led.c"
-static uint8_t RGB_regs[8] = { 0 };
 
 uint8_t ria816_rgb_read(ria816_t* c, uint8_t reg) {
-    return RGB_regs[reg & 0x07];
+    return c->rgb_regs[reg & 0x07];
 }
 void ria816_rgb_write(ria816_t* c, uint8_t reg, uint8_t data) {
-    RGB_regs[reg] = data & 0x07;
+    c->rgb_regs[reg] = data & 0x07;
 
-    RGB_regs[reg] = data;
+    c->rgb_regs[reg] = data;
 
     switch (reg) {
         case 0:
@@ -282,7 +300,7 @@ void ria816_rgb_write(ria816_t* c, uint8_t reg, uint8_t data) {
             led_set_pixel_rgb332(reg, data);
             break;
         case 4:  // RGB888 LED set
-            led_set_pixel(data, RGB_regs[5], RGB_regs[6], RGB_regs[7]);
+            led_set_pixel(data, c->rgb_regs[5], c->rgb_regs[6], c->rgb_regs[7]);
             break;
     }
 }
@@ -178,6 +178,9 @@ typedef struct {
     void* user_data;
 } ria816_desc_t;
 
+// size of the API call parameter stack
+#define RIA816_XSTACK_SIZE (0x200)
+
 // ria816 state
 typedef struct {
     uint8_t reg[RIA816_NUM_REGS];
@@ -190,6 +193,11 @@ typedef struct {
     int ticks_per_ms;
     int ticks_counter;
     uint64_t pins;
+    uint8_t hid_dev;     // selected HID device
+    uint8_t rgb_regs[8];
+    // API call parameter stack, grows down from RIA816_XSTACK_SIZE
+    uint8_t xstack[RIA816_XSTACK_SIZE + 1];
+    size_t xstack_ptr;
     // API callback
     ria816_api_call_t api_cb;
     // optional user-data for the API callback
@@ -210,6 +218,10 @@ void ria816_init(ria816_t* ria816, const ria816_desc_t* desc);
 void ria816_reset(ria816_t* ria816);
 // tick the RIA816
 uint64_t ria816_tick(ria816_t* ria816, uint64_t pins);
+// number of upcoming ticks without chip-select which don't change anything but the tick counter
+uint32_t ria816_idle_ticks(const ria816_t* ria816);
+// advance the tick counter by up to ria816_idle_ticks() ticks without chip-select
+void ria816_skip_ticks(ria816_t* ria816, uint32_t num_ticks);
 
 uint8_t ria816_uart_status(const ria816_t* c);
 uint8_t ria816_reg_read(ria816_t* c, uint8_t addr);
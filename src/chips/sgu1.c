@@ -98,6 +98,15 @@ static void _sgu1_write(sgu1_t* sgu, uint64_t pins) {
     sgu1_reg_write(sgu, reg, data);
 }
 
+uint32_t sgu1_idle_ticks(const sgu1_t* sgu) {
+    return (uint32_t)(sgu->tick_counter - 1) / SGU1_FIXEDPOINT_SCALE;
+}
+
+void sgu1_skip_ticks(sgu1_t* sgu, uint32_t num_ticks) {
+    CHIPS_ASSERT(num_ticks <= sgu1_idle_ticks(sgu));
+    sgu->tick_counter -= (int)num_ticks * SGU1_FIXEDPOINT_SCALE;
+}
+
 /* the all-in-one tick function */
 uint64_t sgu1_tick(sgu1_t* sgu, uint64_t pins) {
     CHIPS_ASSERT(sgu);
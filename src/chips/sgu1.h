@@ -130,6 +130,10 @@ void sgu1_init(sgu1_t* sgu, const sgu1_desc_t* desc);
 void sgu1_reset(sgu1_t* sgu);
 // tick a sgu1_t instance
 uint64_t sgu1_tick(sgu1_t* sgu, uint64_t pins);
+// number of upcoming ticks without chip-select before the next sample
+uint32_t sgu1_idle_ticks(const sgu1_t* sgu);
+// advance the sample counter by up to sgu1_idle_ticks() ticks without chip-select
+void sgu1_skip_ticks(sgu1_t* sgu, uint32_t num_ticks);
 
 // for use by debugger
 uint8_t sgu1_reg_read(sgu1_t* sgu, uint8_t reg);
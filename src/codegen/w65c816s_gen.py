@@ -2,6 +2,7 @@
 #   w65c816s_decoder.py
 #   Generate instruction decoder for w65c816s.h emulator.
 #-------------------------------------------------------------------------------
+import re
 import templ
 
 INOUT_PATH = '../chips/w65c816s.h'
@@ -78,6 +79,11 @@ addr_mode_str = [
     '', 'INVALID'
 ]
 
+# decoder tables, selected by IR bits 12..14
+# (native mode with X in bit 12 and M in bit 13, or emulation mode)
+# as (E, M, X) flag values
+modes = [ (0,0,0), (0,0,1), (0,1,0), (0,1,1), (1,1,1) ]
+
 # memory access modes
 M___ = 0        # no memory access
 M_R_ = 1        # read access
@@ -158,6 +164,139 @@ def l(s) :
     global out_lines
     out_lines += s + '\n'
 
+#-------------------------------------------------------------------------------
+#   find the closing bracket matching the opening bracket at s[i]
+#
+def closing(s, i):
+    depth = 0
+    for j in range(i, len(s)):
+        if s[j] in '({':
+            depth += 1
+        elif s[j] in ')}':
+            depth -= 1
+            if depth == 0:
+                return j
+    raise Exception('unbalanced: ' + s)
+
+#-------------------------------------------------------------------------------
+#   find the end of an expression starting at s[i], stopping at one of
+#   the given characters outside of brackets
+#
+def expr_end(s, i, stop):
+    depth = 0
+    cond = 0
+    for j in range(i, len(s)):
+        ch = s[j]
+        if ch in '({':
+            depth += 1
+        elif ch in ')}':
+            if depth == 0:
+                return j
+            depth -= 1
+        elif depth == 0:
+            if ch == '?':
+                cond += 1
+            elif ch == ':' and cond > 0:
+                cond -= 1
+            elif ch in stop:
+                return j
+    return len(s)
+
+#-------------------------------------------------------------------------------
+#   remove redundant brackets around an expression
+#
+def unwrap(s):
+    s = s.strip()
+    while s.startswith('(') and closing(s, 0) == len(s)-1:
+        s = s[1:-1]
+    return s
+
+#-------------------------------------------------------------------------------
+#   resolve constant if-statement conditions and ternaries
+#
+def simplify_pass(src):
+    # if-statements
+    i = src.find('if(')
+    while i != -1:
+        if i > 0 and (src[i-1].isalnum() or src[i-1] == '_'):
+            i = src.find('if(', i+1)
+            continue
+        ce = closing(src, i+2)
+        cond = src[i+3:ce]
+        if cond.startswith('0||'):
+            return src[:i+3] + cond[3:] + src[ce:]
+        if cond == '1' or cond.startswith('1||') or cond == '0':
+            val = cond != '0'
+            j = ce + 1
+            if src[j] == '{':
+                te = closing(src, j)
+                then_part = src[j+1:te].strip()
+                end = te + 1
+                else_part = ''
+                if src.startswith('else{', end):
+                    ee = closing(src, end+4)
+                    else_part = src[end+5:ee].strip()
+                    end = ee + 1
+            else:
+                te = expr_end(src, j, ';')
+                then_part = src[j:te+1]
+                end = te + 1
+                else_part = ''
+            return src[:i] + (then_part if val else else_part) + src[end:]
+        i = src.find('if(', i+1)
+    # ternaries with a constant condition, only appearing where
+    # an unbracketed expression is allowed
+    for i in range(1, len(src)-1):
+        if src[i] in '01' and src[i+1] == '?' and src[i-1] in '(=,':
+            te = expr_end(src, i+2, ':')
+            fe = expr_end(src, te+1, ',;')
+            part = src[i+2:te] if src[i] == '1' else src[te+1:fe]
+            return src[:i] + unwrap(part) + src[fe:]
+    return src
+
+#-------------------------------------------------------------------------------
+#   specialize the source of a tick for a decoder table, resolving all
+#   M/X/E flag tests at generation time
+#
+def specialize(src, mode):
+    e, m, x = modes[mode]
+    src = src.replace('_E(c)', str(e))
+    src = src.replace('_a8(c)', str(e|m))
+    src = src.replace('_i8(c)', str(e|x))
+    if not e:
+        # native mode stack pointer is a full 16-bit address
+        i = src.find('_SP(')
+        while i != -1:
+            ce = closing(src, i+3)
+            src = src[:i] + src[i+4:ce] + src[ce+1:]
+            i = src.find('_SP(')
+    while True:
+        res = simplify_pass(src)
+        if res == src:
+            break
+        src = res
+    # drop the zero base address of emulation mode direct page
+    src = src.replace('(0)+', '')
+    src = re.sub(r'(?<![\w)])\((c->\w+)\)', r'\1', src)
+    for f in ['_E(c)', '_a8(c)', '_i8(c)', 'if(0)', 'if(1)', 'if(0||', 'if(1||']:
+        assert f not in src, src
+    return src
+
+#-------------------------------------------------------------------------------
+#   case labels of a tick in all given decoder tables
+#
+def case_labels(code, t, group):
+    return ' '.join('case ({}<<12)|(0x{:02X}<<4)|{}:'.format(m, code, t) for m in group)
+
+#-------------------------------------------------------------------------------
+#   group decoder tables with identical source
+#
+def group_modes(srcs):
+    groups = {}
+    for m, src in enumerate(srcs):
+        groups.setdefault(src, []).append(m)
+    return groups.items()
+
 #-------------------------------------------------------------------------------
 def write_op(op):
     if not op.cmt:
@@ -165,9 +304,100 @@ def write_op(op):
     l('    /* {} */'.format(op.cmt if op.cmt else '???'))
     for t in range(0, 9):
         if t < op.i:
-            l('        case (0x{:02X}<<4)|{}: {}break;'.format(op.code, t, op.src[t]))
+            srcs = [specialize(op.src[t], m) for m in range(len(modes))]
+            for src, group in group_modes(srcs):
+                l('        {} {}break;'.format(case_labels(op.code, t, group), src))
         else:
-            l('        case (0x{:02X}<<4)|{}: assert(false);break;'.format(op.code, t))
+            l('        {} assert(false);break;'.format(case_labels(op.code, t, range(len(modes)))))
+
+#-------------------------------------------------------------------------------
+#   output a src line of the instruction-stepped decoder
+#
+step_lines = ''
+def ls(s) :
+    global step_lines
+    step_lines += s + '\n'
+
+#-------------------------------------------------------------------------------
+#   check if a tick ends with an unconditional opcode fetch
+#
+def fetch_at_end(src):
+    if not src.rstrip().endswith('_FETCH();'):
+        return False
+    depth = 0
+    for ch in src[:src.rstrip().rfind('_FETCH();')]:
+        if ch == '{':
+            depth += 1
+        elif ch == '}':
+            depth -= 1
+    return depth == 0
+
+#-------------------------------------------------------------------------------
+#   check if an instruction may leave the sequential instruction flow,
+#   switch the decoder table or stop the CPU
+#
+def ends_block(op):
+    for src in op.src[:op.i]:
+        if re.search(r'c->PC=(?!=)|c->PC\+=|c->PC--|--c->PC|c->PBR=(?!=)|_MODE\(\)|c->stopped=', src):
+            return True
+    return False
+
+#-------------------------------------------------------------------------------
+#   write the ticks of an instruction as one handler function per group of
+#   decoder tables with identical ticks, the ticks fall through into each
+#   other and the memory access of each tick is done inline by _MEM(),
+#   ticks which modify the IR (skipping a tick) dispatch again, ticks which
+#   switch the decoder table continue in the handler of the new table
+#
+step_ops = [None] * (len(modes) * 256)
+step_ends_block = [0] * 256
+def write_step_op(op):
+    step_ends_block[op.code] = 1 if ends_block(op) else 0
+    seqs = [tuple(specialize(op.src[t], m) for t in range(0, op.i)) for m in range(len(modes))]
+    for seq, group in group_modes(seqs):
+        name = '_w65816_step_{:02X}_{}'.format(op.code, group[0])
+        for m in group:
+            step_ops[m * 256 + op.code] = name
+        ls('/* {} */'.format(op.cmt if op.cmt else '???'))
+        ls('static uint64_t {}(w65816_t* c, uint64_t pins, uint32_t* step_cycles) {{'.format(name))
+        ls('    uint32_t cycles = *step_cycles;')
+        ls('    for (;;) switch (c->IR & 0xF) {')
+        for t, src in enumerate(seq):
+            pre = ''
+            if 'c->IR' in src or '_MODE()' in src:
+                pre = 'c->IR=(c->IR&0xF000)|(0x{:02X}<<4)|{};'.format(op.code, t+1)
+            if t == op.i-1 or fetch_at_end(src):
+                post = '_RET();'
+            else:
+                post = 'if(_DONE()){_RET();}' if '_FETCH' in src else ''
+                post += '_NXT();'
+                if '_MODE()' in src:
+                    post += '_DISPATCH();'
+                elif pre:
+                    post += 'continue;'
+                else:
+                    post += '_W65816_FALLTHROUGH;'
+            ls('        case {}: {}{}_MEM();{}'.format(t, pre, src, post))
+        ls('        default: _W65816_UNREACHABLE;')
+        ls('    }')
+        ls('}')
+
+#-------------------------------------------------------------------------------
+#   write the handler table of all decoder tables, and the instructions
+#   which end a basic block
+#
+def write_step_tables():
+    ls('static const w65816_op_t _w65816_step_ops[{}*256] = {{'.format(len(modes)))
+    for m in range(len(modes)):
+        e, mf, xf = modes[m]
+        ls('    /* {} */'.format('Emulation' if e else 'Native M={} X={}'.format(mf, xf)))
+        for i in range(0, 256, 8):
+            ls('    ' + ' '.join(n + ',' for n in step_ops[m*256+i:m*256+i+8]))
+    ls('};')
+    ls('static const uint8_t _w65816_step_ends_block[256] = {')
+    for i in range(0, 256, 32):
+        ls('    ' + ','.join(str(v) for v in step_ends_block[i:i+32]) + ',')
+    ls('};')
 
 #-------------------------------------------------------------------------------
 def cmt(o,cmd):
@@ -336,7 +566,7 @@ def enc_addr(op, addr_mode, mem_access):
 #-------------------------------------------------------------------------------
 def i_brk(o):
     cmt(o, 'BRK')
-    o.t('_VDA(0);if(0==(c->brk_flags&(W65816_BRK_IRQ|W65816_BRK_NMI))){c->PC++;}if(_E(c)){_SAD(_SP(_S(c)--),c->PC>>8);c->IR++;}else{_SAD(_SP(_S(c)--),c->PBR);c->PBR=0;}if(0==(c->brk_flags&W65816_BRK_RESET)){_WR();}else{c->emulation=true;}')
+    o.t('_VDA(0);if(0==(c->brk_flags&(W65816_BRK_IRQ|W65816_BRK_NMI))){c->PC++;}if(_E(c)){_SAD(_SP(_S(c)--),c->PC>>8);c->IR++;}else{_SAD(_SP(_S(c)--),c->PBR);c->PBR=0;}if(0==(c->brk_flags&W65816_BRK_RESET)){_WR();}else{c->emulation=true;_MODE();}')
     o.t('_VDA(0);_SAD(_SP(_S(c)--),c->PC>>8);if(0==(c->brk_flags&W65816_BRK_RESET)){_WR();}')
     o.t('_VDA(0);_SAD(_SP(_S(c)--),c->PC);if(0==(c->brk_flags&W65816_BRK_RESET)){_WR();}')
     o.t('_VDA(0);_SAD(_SP(_S(c)--),(_E(c)?c->P|W65816_UF:c->P));if(c->brk_flags&W65816_BRK_RESET){c->AD=0xFFFC;}else{_WR();if(c->brk_flags&W65816_BRK_NMI){c->AD=_E(c)?0xFFFA:0xFFEA;}else{c->AD=_E(c)?0xFFFE:(c->brk_flags&(W65816_BRK_IRQ)?0xFFEE:0xFFE6);}}')
@@ -507,7 +737,7 @@ def i_xba(o):
 #-------------------------------------------------------------------------------
 def i_xce(o):
     cmt(o,'XCE')
-    o.t('_w65816_xce(c);')
+    o.t('_w65816_xce(c);_MODE();')
 
 #-------------------------------------------------------------------------------
 def i_pha(o):
@@ -561,7 +791,7 @@ def i_plp(o):
     cmt(o,'PLP')
     o.t('_SA(c->PC);') # second junk read from current PC
     o.t('_VDA(0);_SA(_SP(++_S(c)));')   # read actual byte
-    o.t('c->P=_GD();if(_E(c))c->P=(c->P|W65816_BF)&~W65816_UF;');
+    o.t('c->P=_GD();if(_E(c))c->P=(c->P|W65816_BF)&~W65816_UF;_MODE();');
 
 #-------------------------------------------------------------------------------
 def i_phb(o):
@@ -633,13 +863,13 @@ def i_cl(o, f):
 #-------------------------------------------------------------------------------
 def i_sep(o):
     cmt(o,'SEP')
-    o.t('c->P|=_GD();_SA(c->PC);')
+    o.t('c->P|=_GD();_MODE();_SA(c->PC);')
     o.t('') # junk read during P operation
 
 #-------------------------------------------------------------------------------
 def i_rep(o):
     cmt(o,'REP')
-    o.t('c->P&=~_GD();_SA(c->PC);')
+    o.t('c->P&=~_GD();_MODE();_SA(c->PC);')
     o.t('') # junk read during P operation
 
 #-------------------------------------------------------------------------------
@@ -779,7 +1009,7 @@ def i_rti(o):
     # load processor status flag from stack
     o.t('_VDA(0);_SA(_SP(++_S(c)));')
     # load return address low byte from stack
-    o.t('_VDA(0);_SA(_SP(++_S(c)));c->P=_GD();if(_E(c))c->P=(c->P|W65816_BF)&~W65816_UF;')
+    o.t('_VDA(0);_SA(_SP(++_S(c)));c->P=_GD();if(_E(c))c->P=(c->P|W65816_BF)&~W65816_UF;_MODE();')
     # load return address high byte from stack
     o.t('_VDA(0);_SA(_SP(++_S(c)));c->AD=_GD();')
     # update PC (which is already placed on the right return-to instruction)
@@ -1153,11 +1383,15 @@ def write_result():
     with open(INOUT_PATH, 'r') as f:
         lines = f.read().splitlines()
         lines = templ.replace(lines, 'decoder', out_lines)
+        lines = templ.replace(lines, 'step_ops', step_lines)
     out_str = '\n'.join(lines) + '\n'
     with open(INOUT_PATH, 'w') as f:
         f.write(out_str)
 
 if __name__ == '__main__':
     for op in range(0, 256):
-        write_op(enc_op(op))
+        o = enc_op(op)
+        write_op(o)
+        write_step_op(o)
+    write_step_tables()
     write_result()
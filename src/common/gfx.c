@@ -14,16 +14,20 @@
 #include <string.h>
 
 #define GFX_DEF(v,def) (v?v:def)
+#define GFX_FB_BANDS (8)    // framebuffer textures, rows are uploaded a band at a time
 
 typedef struct {
     bool valid;
     bool disable_speaker_icon;
     gfx_border_t border;
     struct {
-        struct {   // framebuffer texture, RGBA8 or R8 if paletted
+        struct {   // framebuffer texture of a band of rows, RGBA8 or R8 if paletted
             sg_image img;
             sg_view tex_view;
-        } vidmem;
+            int top, height;
+        } vidmem[GFX_FB_BANDS];
+        int num_bands;
+        bool uploaded;  // all bands hold the framebuffer rows
         struct {   // optional color palette texture
             sg_image img;
             sg_view tex_view;
@@ -35,6 +39,7 @@ typedef struct {
     struct {
         chips_rect_t viewport;
         chips_dim_t pixel_aspect;
+        chips_dim_t scale;
         sg_image img;
         sg_view tex_view;
         sg_sampler smp;
@@ -252,27 +257,39 @@ sg_view gfx_create_icon_texview(const uint8_t* packed_pixels, int width, int hei
 // this function will be called at init time and when the emulator framebuffer size changes
 static void gfx_init_images_and_pass(void) {
     // destroy previous resources (if exist)
-    sg_destroy_image(state.fb.vidmem.img);
-    sg_destroy_view(state.fb.vidmem.tex_view);
+    for (int i = 0; i < GFX_FB_BANDS; i++) {
+        sg_destroy_image(state.fb.vidmem[i].img);
+        sg_destroy_view(state.fb.vidmem[i].tex_view);
+    }
     sg_destroy_sampler(state.fb.smp);
     sg_destroy_image(state.offscreen.img);
     sg_destroy_view(state.offscreen.tex_view);
     sg_destroy_view(state.offscreen.pass.attachments.colors[0]);
     sg_destroy_sampler(state.offscreen.smp);
 
-    // an image and texture-view with the emulator's raw pixel data
+    // images and texture-views with the emulator's raw pixel data, split into
+    // bands of rows so that only the changed rows need to be uploaded
     assert((state.fb.dim.width > 0) && (state.fb.dim.height > 0));
-    state.fb.vidmem.img = sg_make_image(&(sg_image_desc){
-        .usage.stream_update = true,
-        .width = state.fb.dim.width,
-        .height = state.fb.dim.height,
-        .pixel_format = state.fb.paletted ? SG_PIXELFORMAT_R8 : SG_PIXELFORMAT_RGBA8,
-        .label = "vidmem-image",
-    });
-    state.fb.vidmem.tex_view = sg_make_view(&(sg_view_desc){
-        .texture.image = state.fb.vidmem.img,
-        .label = "vidmem-tex-view",
-    });
+    const int band_height = (state.fb.dim.height + GFX_FB_BANDS - 1) / GFX_FB_BANDS;
+    state.fb.num_bands = 0;
+    for (int top = 0; top < state.fb.dim.height; top += band_height) {
+        const int height = (state.fb.dim.height - top) < band_height ? (state.fb.dim.height - top) : band_height;
+        state.fb.vidmem[state.fb.num_bands].top = top;
+        state.fb.vidmem[state.fb.num_bands].height = height;
+        state.fb.vidmem[state.fb.num_bands].img = sg_make_image(&(sg_image_desc){
+            .usage.stream_update = true,
+            .width = state.fb.dim.width,
+            .height = height,
+            .pixel_format = state.fb.paletted ? SG_PIXELFORMAT_R8 : SG_PIXELFORMAT_RGBA8,
+            .label = "vidmem-image",
+        });
+        state.fb.vidmem[state.fb.num_bands].tex_view = sg_make_view(&(sg_view_desc){
+            .texture.image = state.fb.vidmem[state.fb.num_bands].img,
+            .label = "vidmem-tex-view",
+        });
+        state.fb.num_bands++;
+    }
+    state.fb.uploaded = false;
 
     // a sampler for sampling the emulators raw pixel data
     state.fb.smp = sg_make_sampler(&(sg_sampler_desc){
@@ -283,12 +300,13 @@ static void gfx_init_images_and_pass(void) {
         .label = "vidmem-sampler",
     });
 
-    // 2x-upscaling render target image, views and sampler
+    // 2x-upscaling render target image, views and sampler, on top of the
+    // framebuffer's own pixel repetition
     assert((state.offscreen.viewport.width > 0) && (state.offscreen.viewport.height > 0));
     state.offscreen.img = sg_make_image(&(sg_image_desc){
         .usage.color_attachment = true,
-        .width = 2 * state.offscreen.viewport.width,
-        .height = 2 * state.offscreen.viewport.height,
+        .width = 2 * state.offscreen.scale.width * state.offscreen.viewport.width,
+        .height = 2 * state.offscreen.scale.height * state.offscreen.viewport.height,
         .sample_count = 1,
         .label = "upscale-image"
     });
@@ -347,8 +365,11 @@ void gfx_init(const gfx_desc_t* desc) {
     state.draw_extra_cb = desc->draw_extra_cb;
     state.fb.dim =  desc->display_info.frame.dim;
     state.fb.paletted = 0 != desc->display_info.palette.ptr;
-    state.offscreen.pixel_aspect.width = GFX_DEF(desc->pixel_aspect.width, 1);
-    state.offscreen.pixel_aspect.height = GFX_DEF(desc->pixel_aspect.height, 1);
+    state.offscreen.scale.width = GFX_DEF(desc->frame_scale.width, 1);
+    state.offscreen.scale.height = GFX_DEF(desc->frame_scale.height, 1);
+    // a repeated framebuffer pixel covers scale.width x scale.height display pixels
+    state.offscreen.pixel_aspect.width = GFX_DEF(desc->pixel_aspect.width, 1) * state.offscreen.scale.width;
+    state.offscreen.pixel_aspect.height = GFX_DEF(desc->pixel_aspect.height, 1) * state.offscreen.scale.height;
     state.offscreen.viewport = desc->display_info.screen;
 
     if (state.fb.paletted) {
@@ -542,37 +563,65 @@ void gfx_draw(chips_display_info_t display_info) {
         sgl_end();
     }
 
-    // copy emulator pixel data into emulator framebuffer texture
-    sg_update_image(state.fb.vidmem.img, &(sg_image_data){
-        .mip_levels[0] = {
-            .ptr = display_info.frame.buffer.ptr,
-            .size = display_info.frame.buffer.size,
+    // copy changed emulator pixel rows into the emulator framebuffer textures
+    const bool all_dirty = !state.fb.uploaded || !display_info.dirty.valid;
+    const size_t row_size = display_info.frame.buffer.size / (size_t)state.fb.dim.height;
+    for (int i = 0; i < state.fb.num_bands; i++) {
+        const int top = state.fb.vidmem[i].top;
+        const int height = state.fb.vidmem[i].height;
+        if (all_dirty || ((top < display_info.dirty.bottom) && (top + height > display_info.dirty.top))) {
+            sg_update_image(state.fb.vidmem[i].img, &(sg_image_data){
+                .mip_levels[0] = {
+                    .ptr = (const uint8_t*)display_info.frame.buffer.ptr + top * row_size,
+                    .size = height * row_size,
+                }
+            });
         }
-    });
+    }
+    state.fb.uploaded = true;
 
-    // upscale the original framebuffer 2x with nearest filtering
+    // upscale the original framebuffer 2x (times the frame scale) with nearest filtering,
+    // band by band, each into its rows of the render target
     sg_begin_pass(&state.offscreen.pass);
     sg_apply_pipeline(state.offscreen.pip);
-    sg_apply_bindings(&(sg_bindings){
-        .vertex_buffers[0] = state.offscreen.vbuf,
-        .views = {
-            [VIEW_fb_tex] = state.fb.vidmem.tex_view,
-            [VIEW_pal_tex] = state.fb.pal.tex_view,
-        },
-        .samplers[SMP_smp] = state.fb.smp,
-    });
-    const offscreen_vs_params_t vs_params = {
-        .uv_offset = {
-            (float)state.offscreen.viewport.x / (float)state.fb.dim.width,
-            (float)state.offscreen.viewport.y / (float)state.fb.dim.height,
-        },
-        .uv_scale = {
-            (float)state.offscreen.viewport.width / (float)state.fb.dim.width,
-            (float)state.offscreen.viewport.height / (float)state.fb.dim.height
+    const chips_rect_t view = state.offscreen.viewport;
+    const float target_width = (float)(2 * state.offscreen.scale.width * view.width);
+    const float target_height = (float)(2 * state.offscreen.scale.height * view.height);
+    for (int i = 0; i < state.fb.num_bands; i++) {
+        const int band_top = state.fb.vidmem[i].top;
+        const int band_height = state.fb.vidmem[i].height;
+        const int top = band_top > view.y ? band_top : view.y;
+        const int bottom = (band_top + band_height) < (view.y + view.height) ? (band_top + band_height) : (view.y + view.height);
+        if (top >= bottom) {
+            continue;
         }
-    };
-    sg_apply_uniforms(UB_offscreen_vs_params, &SG_RANGE(vs_params));
-    sg_draw(0, 4, 1);
+        sg_apply_viewportf(
+            0.0f,
+            target_height * (float)(top - view.y) / (float)view.height,
+            target_width,
+            target_height * (float)(bottom - top) / (float)view.height,
+            false);
+        sg_apply_bindings(&(sg_bindings){
+            .vertex_buffers[0] = state.offscreen.vbuf,
+            .views = {
+                [VIEW_fb_tex] = state.fb.vidmem[i].tex_view,
+                [VIEW_pal_tex] = state.fb.pal.tex_view,
+            },
+            .samplers[SMP_smp] = state.fb.smp,
+        });
+        const offscreen_vs_params_t vs_params = {
+            .uv_offset = {
+                (float)view.x / (float)state.fb.dim.width,
+                (float)(top - band_top) / (float)band_height,
+            },
+            .uv_scale = {
+                (float)view.width / (float)state.fb.dim.width,
+                (float)(bottom - top) / (float)band_height,
+            }
+        };
+        sg_apply_uniforms(UB_offscreen_vs_params, &SG_RANGE(vs_params));
+        sg_draw(0, 4, 1);
+    }
     sg_end_pass();
 
     // tint the clear color red or green if flash feedback is requested
@@ -604,8 +653,9 @@ void gfx_draw(chips_display_info_t display_info) {
         });
         // fade out the shadow mask when the output is too small to resolve
         // a clean 3-pixel-wide triad (avoids ugly moire at low scales)
-        const float mask_scale = (vp.height >= 2 * display_info.screen.height) ? 1.0f
-            : (float)vp.height / (float)(2 * display_info.screen.height);
+        const int screen_height = state.offscreen.scale.height * display_info.screen.height;
+        const float mask_scale = (vp.height >= 2 * screen_height) ? 1.0f
+            : (float)vp.height / (float)(2 * screen_height);
         const display_crt_fs_params_t crt_uniforms = {
             .output_size        = { (float)vp.width, (float)vp.height },
             .scanline_intensity = state.display.crt_params.scanline_intensity,
@@ -30,6 +30,7 @@ typedef struct {
     gfx_border_t border;
     chips_display_info_t display_info;
     chips_dim_t pixel_aspect;   // optional pixel aspect ratio, default is 1:1
+    chips_dim_t frame_scale;    // optional integer scale-up of framebuffer pixels, default is 1x1
     gfx_init_extra_t init_extra_cb;
     gfx_draw_extra_t draw_extra_cb;
 } gfx_desc_t;
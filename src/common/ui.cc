@@ -242,7 +242,7 @@ ui_texture_t ui_create_screenshot_texture(chips_display_info_t info) {
             for (size_t x = 0; x < (size_t)info.screen.width; x++) {
                 uint8_t p = pixels[(y + info.screen.y) * info.frame.dim.width + (x + info.screen.x)];
                 assert(p < num_palette_entries); (void)num_palette_entries;
-                uint32_t c = (palette[p] >> 2) & 0x3F3F3F3F;
+                uint32_t c = ((palette[p] | 0xFF000000) >> 2) & 0x3F3F3F3F;  // palette alpha may be unset
                 size_t dst_x = x >> 1;
                 size_t dst_y = y >> 1;
                 if (info.portrait) {
@@ -123,6 +123,12 @@ EMSCRIPTEN_KEEPALIVE void webapi_reset(void) {
     }
 }
 
+EMSCRIPTEN_KEEPALIVE void webapi_warp(bool enable) {
+    if (state.inited && state.funcs.warp) {
+        state.funcs.warp(enable);
+    }
+}
+
 EMSCRIPTEN_KEEPALIVE bool webapi_ready(void) {
     if (state.inited && state.funcs.ready) {
         return state.funcs.ready();
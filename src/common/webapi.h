@@ -87,6 +87,7 @@ typedef struct {
 typedef struct {
     void (*boot)(void);
     void (*reset)(void);
+    void (*warp)(bool enable);  // run as fast as possible
     bool (*ready)(void);
     bool (*load)(chips_range_t data);  // data starts with a webapi_fileheader_t
     bool (*load_file)(const char* file);
@@ -29,11 +29,21 @@ struct EmuLaunchRequest: public dap::LaunchRequest {
     dap::optional<dap::boolean> stopOnEntry;
 };
 
+/// Custom "warp" request, runs the emulation unthrottled while enabled
+struct EmuWarpResponse: public dap::Response {};
+
+struct EmuWarpRequest: public dap::Request {
+    using Response = EmuWarpResponse;
+    dap::boolean enable;
+};
+
 namespace dap {
 DAP_STRUCT_TYPEINFO_EXT(EmuLaunchRequest,
                         LaunchRequest,
                         "launch",
                         DAP_FIELD(stopOnEntry, "stopOnEntry"));
+DAP_STRUCT_TYPEINFO(EmuWarpResponse, "");
+DAP_STRUCT_TYPEINFO(EmuWarpRequest, "warp", DAP_FIELD(enable, "enable"));
 }  // namespace dap
 
 #ifdef _MSC_VER
@@ -128,6 +138,13 @@ static void dap_reset(void) {
     }
 }
 
+static void dap_warp(bool enable) {
+    if (state.inited && state.funcs.warp) {
+        LOG_INFO("warp(%d) called", enable);
+        state.funcs.warp(enable);
+    }
+}
+
 static bool dap_is_ready(void) {
     if (state.inited && state.funcs.ready) {
         // LOG_INFO("ready() called");
@@ -367,6 +384,8 @@ void dap_event_reset(void) {
 static bool do_dap_boot = false;
 static bool do_send_thread_info = false;
 static bool do_dap_reset = false;
+static bool do_dap_warp = false;
+static bool dap_warp_enable = false;
 static bool do_dap_pause = false;
 static bool do_dap_continue = false;
 static bool do_dap_stepForward = false;
@@ -702,6 +721,14 @@ void dap_register_session(dap::Session* session) {
         return dap::RestartResponse();
     });
 
+    // Handler for the custom warp request
+    session->registerHandler([&](const EmuWarpRequest& request) {
+        LOG_INFO("Warp request");
+        dap_warp_enable = request.enable;
+        do_dap_warp = true;
+        return EmuWarpResponse();
+    });
+
     // The ConfigurationDone request is made by the client once all configuration
     // requests have been made.
     // https://microsoft.github.io/debug-adapter-protocol/specification#Requests_ConfigurationDone
@@ -1253,6 +1280,15 @@ void dap_shutdown() {
  * This function is being called from main frame handler thread.
  * It is used to safely cross DAP server and Emu thread boundary.
  */
+bool dap_pending(void) {
+    if (do_send_thread_info || do_dap_boot || do_dap_reset || do_dap_warp || do_dap_pause || do_dap_continue
+        || do_dap_stepForward || do_dap_stepIn) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(dap_breakpoints_update_mutex);
+    return !dap_breakpoints_update.empty();
+}
+
 void dap_process() {
     if (do_send_thread_info && dap_is_ready()) {
         do_send_thread_info = false;
@@ -1290,6 +1326,12 @@ void dap_process() {
         dap_reset();
     }
 
+    if (do_dap_warp) {
+        do_dap_warp = false;
+
+        dap_warp(dap_warp_enable);
+    }
+
     if (do_dap_pause) {
         do_dap_pause = false;
 
@@ -16,6 +16,8 @@ typedef struct {
 void dap_init(const dap_desc_t* desc);
 void dap_shutdown();
 void dap_process();
+// true if requests are waiting for dap_process()
+bool dap_pending(void);
 
 // stop_reason: WEBAPI_STOPREASON_xxx
 void dap_event_stopped(int stop_reason, uint32_t addr);
@@ -0,0 +1,336 @@
+#include "./emu_thread.h"
+#include "./log.h"
+#include "util/spscqueue.h"
+#include "util/triplebuffer.h"
+
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// cap a frame like clock_frame_time() does, to avoid a death spiral
+#define EMU_THREAD_MAX_FRAME_US (24000)
+// log lines queued for the main thread, more are dropped until it catches up
+#define EMU_THREAD_LOG_LINES (64)
+
+typedef struct {
+    uint32_t log_level;
+    uint32_t log_item;
+    char log_id[64];
+    char message[512];
+} emu_thread_log_line_t;
+
+static struct {
+    x65_t* sys;
+    SDL_Thread* thread;
+    // held only to apply commands and to publish a frame, x65_exec() runs
+    // unlocked, the main thread takes the machine between frames
+    SDL_Mutex* lock;
+    SDL_Condition* cond;
+    bool busy;           // the thread is inside a frame
+    bool parked;         // the main thread has the machine, don't start a frame
+    uint32_t lock_depth;  // nesting of emu_thread_lock() on the main thread
+    atomic_bool quit;
+    atomic_bool warp;
+    atomic_uint run_ahead;
+    x65_runahead_t runahead;
+    spsc_queue_t cmds;
+    triple_buffer_t frames;
+    emu_thread_stats_t stats;
+    // the machine logs from the thread, the lines wait here for the main thread
+    SDL_Mutex* log_lock;
+    uint32_t log_head;  // oldest queued line
+    uint32_t log_count;
+    uint32_t log_dropped;
+    emu_thread_log_line_t log[EMU_THREAD_LOG_LINES];
+    _Atomic uint32_t dirty;  // rows changed since the consumer last took the range, packed bottom << 16 | top
+    cgia_dirty_t stale[3];   // rows of the machine framebuffer changed since each buffer was last written
+    alignas(64) uint32_t fb[3][CGIA_FRAMEBUFFER_SIZE_BYTES / 4];
+} state;
+
+static uint32_t emu_thread_pack_dirty(cgia_dirty_t dirty) {
+    return ((uint32_t)dirty.bottom << 16) | dirty.top;
+}
+
+// add the rows changed in the frame just published to the range the consumer takes,
+// done after publishing, so a range is never taken before the frame holding it
+static void emu_thread_merge_dirty(cgia_dirty_t dirty) {
+    if (dirty.top >= dirty.bottom) return;
+    uint32_t prev = atomic_load(&state.dirty);
+    cgia_dirty_t merged;
+    do {
+        merged.top = (uint16_t)(prev & 0xFFFF);
+        merged.bottom = (uint16_t)(prev >> 16);
+        if (dirty.top < merged.top) merged.top = dirty.top;
+        if (dirty.bottom > merged.bottom) merged.bottom = dirty.bottom;
+    } while (!atomic_compare_exchange_weak(&state.dirty, &prev, emu_thread_pack_dirty(merged)));
+}
+
+// add the rows changed in the last frame to the stale rows of every buffer,
+// then bring the back buffer up to date by copying only its stale rows
+static void emu_thread_fill_back(cgia_dirty_t dirty) {
+    const size_t row_bytes = sizeof(state.sys->fb) / CGIA_FRAMEBUFFER_HEIGHT;
+    void* back = tb_back(&state.frames);
+    for (int i = 0; i < 3; i++) {
+        cgia_dirty_t* stale = &state.stale[i];
+        if (dirty.top < stale->top) stale->top = dirty.top;
+        if (dirty.bottom > stale->bottom) stale->bottom = dirty.bottom;
+        if ((state.fb[i] == back) && (stale->top < stale->bottom)) {
+            memcpy(
+                (uint8_t*)back + stale->top * row_bytes,
+                (const uint8_t*)state.sys->fb + stale->top * row_bytes,
+                (stale->bottom - stale->top) * row_bytes);
+            *stale = CGIA_DIRTY_NONE;
+        }
+    }
+}
+
+// a command item holds the posting time in microseconds, the command and its argument
+#define EMU_THREAD_ITEM(us, cmd, arg) (((uint64_t)(us) << 32) | ((uint64_t)(cmd) << 24) | ((uint32_t)(arg) & 0xFFFFFF))
+
+static void emu_thread_handle_cmd(uint64_t item, uint32_t frame_start_us) {
+    // commands posted during the last period are replayed at the same offset
+    // into this one, x65_exec() clamps late ones to the end of the frame
+    const uint32_t offset_us = (uint32_t)(item >> 32) - frame_start_us;
+    const int32_t arg = (int32_t)(item & 0xFFFFFF);
+    switch ((emu_thread_cmd_t)((item >> 24) & 0xFF)) {
+        case EMU_THREAD_KEY_DOWN: x65_input(state.sys, X65_INPUT_KEY_DOWN, arg, offset_us); break;
+        case EMU_THREAD_KEY_UP: x65_input(state.sys, X65_INPUT_KEY_UP, arg, offset_us); break;
+        case EMU_THREAD_KEY_TAP: x65_input(state.sys, X65_INPUT_KEY_TAP, arg, offset_us); break;
+    }
+}
+
+static int emu_thread_func(void* data) {
+    (void)data;
+    const uint64_t period_ns = SDL_NS_PER_SECOND / MODE_V_FREQ_HZ;
+    uint64_t last = SDL_GetTicksNS();
+    while (!atomic_load(&state.quit)) {
+        const uint64_t now = SDL_GetTicksNS();
+        uint64_t frame_time_us = (now - last) / SDL_NS_PER_US;
+        if (frame_time_us > EMU_THREAD_MAX_FRAME_US) {
+            frame_time_us = EMU_THREAD_MAX_FRAME_US;
+        }
+        const uint32_t frame_start_us = (uint32_t)(last / SDL_NS_PER_US);
+        last = now;
+
+        SDL_LockMutex(state.lock);
+        while (state.parked) {
+            SDL_WaitCondition(state.cond, state.lock);
+        }
+        uint64_t item;
+        while (spsc_pop(&state.cmds, &item)) {
+            emu_thread_handle_cmd(item, frame_start_us);
+        }
+        state.busy = true;
+        SDL_UnlockMutex(state.lock);
+
+        const uint32_t run_ahead = atomic_load(&state.run_ahead);
+        uint32_t ticks = 0;
+        if (atomic_load(&state.warp)) {
+            // most of the period, the frame with output keeps a trickle of audio
+            ticks = x65_exec_warp(state.sys, (uint32_t)(period_ns * 3 / 4 / SDL_NS_PER_US));
+        }
+        else if (run_ahead > 0) {
+            ticks = x65_exec_runahead(state.sys, &state.runahead, (uint32_t)frame_time_us, run_ahead);
+        }
+        else {
+            ticks = x65_exec(state.sys, (uint32_t)frame_time_us);
+        }
+        if (!atomic_load(&state.warp)) {
+            const uint64_t exec_us = (SDL_GetTicksNS() - now) / SDL_NS_PER_US;
+            x65_adapt_frame_skip(state.sys, (uint32_t)frame_time_us, (uint32_t)exec_us);
+        }
+        emu_thread_fill_back(state.sys->fb_dirty);
+        emu_thread_stats_t stats = {
+            .frame_time_us = (uint32_t)frame_time_us,
+            .ticks = ticks,
+            .emu_time_ms = (double)(SDL_GetTicksNS() - now) / SDL_NS_PER_MS,
+        };
+        emu_thread_machine_stats(state.sys, &stats);
+
+        SDL_LockMutex(state.lock);
+        tb_publish(&state.frames);
+        emu_thread_merge_dirty(state.sys->fb_dirty);
+        x65_display_presented(state.sys);
+        state.stats = stats;
+        state.busy = false;
+        SDL_BroadcastCondition(state.cond);
+        SDL_UnlockMutex(state.lock);
+
+        const uint64_t done = SDL_GetTicksNS();
+        if (!atomic_load(&state.warp) && (done - now < period_ns)) {
+            SDL_DelayPrecise(period_ns - (done - now));
+        }
+    }
+    return 0;
+}
+
+// let the thread start the next frame
+static void emu_thread_unpark(void) {
+    SDL_LockMutex(state.lock);
+    state.parked = false;
+    SDL_BroadcastCondition(state.cond);
+    SDL_UnlockMutex(state.lock);
+}
+
+void emu_thread_start(x65_t* sys) {
+    assert(sys && !state.thread);
+    state.sys = sys;
+    state.lock = SDL_CreateMutex();
+    state.cond = SDL_CreateCondition();
+    state.log_lock = SDL_CreateMutex();
+    state.log_head = state.log_count = state.log_dropped = 0;
+    state.busy = state.parked = false;
+    state.lock_depth = 0;
+    atomic_store(&state.quit, false);
+    spsc_init(&state.cmds);
+    tb_init(&state.frames, state.fb[0], state.fb[1], state.fb[2]);
+    atomic_store(&state.dirty, emu_thread_pack_dirty(CGIA_DIRTY_ALL));
+    x65_runahead_init(&state.runahead);
+    for (int i = 0; i < 3; i++) {
+        memcpy(state.fb[i], sys->fb, sizeof(sys->fb));
+        state.stale[i] = CGIA_DIRTY_NONE;
+    }
+    state.thread = SDL_CreateThread(emu_thread_func, "x65", NULL);
+    if (!state.thread) {
+        SDL_DestroyCondition(state.cond);
+        SDL_DestroyMutex(state.lock);
+        SDL_DestroyMutex(state.log_lock);
+        state.cond = NULL;
+        state.lock = NULL;
+        state.log_lock = NULL;
+        x65_runahead_discard(&state.runahead);
+        LOG_ERROR("Can't start emulation thread: %s", SDL_GetError());
+    }
+}
+
+void emu_thread_stop(void) {
+    if (!state.thread) return;
+    atomic_store(&state.quit, true);
+    emu_thread_unpark();
+    SDL_WaitThread(state.thread, NULL);
+    SDL_DestroyCondition(state.cond);
+    SDL_DestroyMutex(state.lock);
+    SDL_DestroyMutex(state.log_lock);
+    x65_runahead_discard(&state.runahead);
+    state.thread = NULL;
+    state.cond = NULL;
+    state.lock = NULL;
+    state.log_lock = NULL;
+}
+
+bool emu_thread_running(void) {
+    return state.thread != NULL;
+}
+
+void emu_thread_lock(void) {
+    if (!state.thread || (state.lock_depth++ > 0)) return;
+    SDL_LockMutex(state.lock);
+    state.parked = true;
+    while (state.busy) {
+        SDL_WaitCondition(state.cond, state.lock);
+    }
+    SDL_UnlockMutex(state.lock);
+}
+
+void emu_thread_unlock(void) {
+    if (!state.thread) return;
+    assert(state.lock_depth > 0);
+    if (--state.lock_depth == 0) {
+        emu_thread_unpark();
+    }
+}
+
+bool emu_thread_post(emu_thread_cmd_t cmd, int32_t arg) {
+    const uint32_t now_us = (uint32_t)(SDL_GetTicksNS() / SDL_NS_PER_US);
+    return spsc_push(&state.cmds, EMU_THREAD_ITEM(now_us, cmd, arg));
+}
+
+void emu_thread_set_warp(bool warp) {
+    atomic_store(&state.warp, warp);
+}
+
+void emu_thread_set_run_ahead(uint32_t num_frames) {
+    atomic_store(&state.run_ahead, num_frames);
+}
+
+chips_display_info_t emu_thread_display_info(void) {
+    chips_display_info_t info = x65_display_info(state.sys);
+    // take the range before the frame, rows of a frame published in between
+    // stay in the range for the next call
+    const uint32_t dirty = atomic_exchange(&state.dirty, emu_thread_pack_dirty(CGIA_DIRTY_NONE));
+    info.frame.buffer.ptr = tb_front(&state.frames);
+    info.dirty.top = (int)(dirty & 0xFFFF);
+    info.dirty.bottom = (int)(dirty >> 16);
+    return info;
+}
+
+emu_thread_stats_t emu_thread_stats(void) {
+    if (!state.thread) {
+        return state.stats;
+    }
+    SDL_LockMutex(state.lock);
+    const emu_thread_stats_t stats = state.stats;
+    SDL_UnlockMutex(state.lock);
+    return stats;
+}
+
+void emu_thread_machine_stats(x65_t* sys, emu_thread_stats_t* stats) {
+    stats->joystick_type = x65_joystick_type(sys);
+    stats->joystick_mask = x65_joystick_mask(sys);
+    stats->frame_skip_enabled = sys->frame_skip.enabled;
+    stats->frame_skip = sys->cgia.frame_skip;
+    uint32_t* leds;
+    size_t num_leds;
+    ria816_rgb_get_leds(&leds, &num_leds);
+    stats->num_leds = (num_leds < EMU_THREAD_MAX_LEDS) ? (uint32_t)num_leds : EMU_THREAD_MAX_LEDS;
+    memcpy(stats->leds, leds, stats->num_leds * sizeof(uint32_t));
+}
+
+bool emu_thread_log(uint32_t log_level, uint32_t log_item, const char* log_id, const char* message) {
+    // the lock exists from before the thread starts until after it has stopped
+    if (!state.log_lock) return false;
+    SDL_LockMutex(state.log_lock);
+    if (state.log_count < EMU_THREAD_LOG_LINES) {
+        emu_thread_log_line_t* line = &state.log[(state.log_head + state.log_count++) % EMU_THREAD_LOG_LINES];
+        line->log_level = log_level;
+        line->log_item = log_item;
+        SDL_strlcpy(line->log_id, log_id, sizeof(line->log_id));
+        SDL_strlcpy(line->message, message, sizeof(line->message));
+    }
+    else {
+        state.log_dropped++;
+    }
+    SDL_UnlockMutex(state.log_lock);
+    return true;
+}
+
+void emu_thread_drain_log(emu_thread_log_func_t func) {
+    if (!state.log_lock) return;
+    for (;;) {
+        // one line at a time, the thread isn't held up by the consumer
+        emu_thread_log_line_t line;
+        uint32_t dropped = 0;
+        SDL_LockMutex(state.log_lock);
+        const bool empty = (0 == state.log_count);
+        if (!empty) {
+            line = state.log[state.log_head];
+            state.log_head = (state.log_head + 1) % EMU_THREAD_LOG_LINES;
+            state.log_count--;
+        }
+        else {
+            dropped = state.log_dropped;
+            state.log_dropped = 0;
+        }
+        SDL_UnlockMutex(state.log_lock);
+        if (empty) {
+            if (dropped) {
+                char message[64];
+                SDL_snprintf(message, sizeof(message), "%u log lines dropped", dropped);
+                func(2, 0, "emu_thread", message);
+            }
+            return;
+        }
+        func(line.log_level, line.log_item, line.log_id, line.message);
+    }
+}
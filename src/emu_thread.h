@@ -0,0 +1,57 @@
+#pragma once
+
+#include "systems/x65.h"
+
+// commands posted to the emulation thread
+typedef enum {
+    EMU_THREAD_KEY_DOWN,
+    EMU_THREAD_KEY_UP,
+    EMU_THREAD_KEY_TAP,  // key down and up, bypassing keyboard joystick emulation
+} emu_thread_cmd_t;
+
+#define EMU_THREAD_MAX_LEDS (16)
+
+typedef struct {
+    uint32_t frame_time_us;  // emulated time of the last frame
+    uint32_t ticks;          // ticks executed in the last frame
+    double emu_time_ms;      // host time spent in x65_exec() in the last frame
+    // machine state shown in the status bar, see emu_thread_machine_stats()
+    x65_joystick_type_t joystick_type;
+    uint8_t joystick_mask;
+    bool frame_skip_enabled;
+    uint32_t frame_skip;  // frames CGIA currently skips between shown frames
+    uint32_t num_leds;
+    uint32_t leds[EMU_THREAD_MAX_LEDS];  // RGB LED colors, GRB8
+} emu_thread_stats_t;
+
+// start running the machine on its own thread
+void emu_thread_start(x65_t* sys);
+// stop the emulation thread, the machine stays valid
+void emu_thread_stop(void);
+bool emu_thread_running(void);
+// exclusive access to the machine for the main thread, waits for the thread to
+// finish the frame in flight and keeps it parked at the frame boundary until
+// the matching unlock, nestable
+void emu_thread_lock(void);
+void emu_thread_unlock(void);
+// queue a command for the emulation thread, stamped with the host time to be
+// applied at the matching point of the next frame, arg is limited to 24 bits,
+// returns false if the queue is full
+bool emu_thread_post(emu_thread_cmd_t cmd, int32_t arg);
+// run unthrottled, presenting one frame per emulation thread period
+void emu_thread_set_warp(bool warp);
+// show the frame num_frames frames ahead of the machine, see x65_exec_runahead()
+void emu_thread_set_run_ahead(uint32_t num_frames);
+// display info pointing at the latest completed frame
+chips_display_info_t emu_thread_display_info(void);
+// statistics of the last emulated frame, published with the frame
+emu_thread_stats_t emu_thread_stats(void);
+// fill the machine state part of the stats from a machine not running
+void emu_thread_machine_stats(x65_t* sys, emu_thread_stats_t* stats);
+
+typedef void (*emu_thread_log_func_t)(uint32_t log_level, uint32_t log_item, const char* log_id, const char* message);
+// queue a log line for emu_thread_drain_log(), callable from any thread, returns
+// false if the thread isn't started and the line is to be handled right away
+bool emu_thread_log(uint32_t log_level, uint32_t log_item, const char* log_id, const char* message);
+// hand the queued log lines to func on the calling (main) thread, oldest first
+void emu_thread_drain_log(emu_thread_log_func_t func);
@@ -2,17 +2,10 @@
 #include "./log.h"
 
 #include "north/hid/pad.h"
-#include "north/hid/kbd.h"
+#include <class/hid/hid.h>
 
 #include <SDL3/SDL.h>
 
-static uint32_t kbd_keys[8] = { 0 };
-
-void hid_reset(void) {
-    memset(kbd_keys, 0, sizeof(kbd_keys));
-    hid_key_up(0);  // fake phantom key up to initialize kbd
-}
-
 void hid_init(void) {
     SDL_Init(SDL_INIT_GAMEPAD);
 }
@@ -21,96 +14,6 @@ void hid_shutdown(void) {
     SDL_QuitSubSystem(SDL_INIT_GAMEPAD);
 }
 
-// SDL3 event handling
-void sdl_poll_events(void) {
-    SDL_Event event;
-    while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_EVENT_QUIT: {
-                sapp_request_quit();
-            } break;
-
-            case SDL_EVENT_JOYSTICK_ADDED: {
-                if (SDL_IsGamepad(event.jdevice.which)) {
-                    // Let's wait for the gamepad added event
-                    continue;
-                }
-
-                LOG_INFO("SDL Joystick %d added.", event.jdevice.which);
-                SDL_Joystick* joystick = SDL_OpenJoystick(event.jdevice.which);
-                if (!joystick) {
-                    LOG_ERROR("SDL_OpenJoystick failed: %s", SDL_GetError());
-                    continue;
-                }
-
-                if (!pad_mount(
-                        event.jdevice.which,
-                        (void*)joystick,
-                        0,
-                        SDL_GetJoystickVendor(joystick),
-                        SDL_GetJoystickProduct(joystick))) {
-                    LOG_ERROR("pad_mount failed for joystick %d", event.jdevice.which);
-                    SDL_CloseJoystick(joystick);
-                }
-            } break;
-            case SDL_EVENT_JOYSTICK_REMOVED: {
-                if (SDL_IsGamepad(event.jdevice.which)) continue;
-                LOG_INFO("SDL Joystick %d removed", event.jdevice.which);
-                SDL_CloseJoystick(SDL_GetJoystickFromID(event.jdevice.which));
-                pad_umount(event.jdevice.which);
-            } break;
-            case SDL_EVENT_GAMEPAD_ADDED: {
-                LOG_INFO("SDL Gamepad %d added", event.gdevice.which);
-                SDL_Gamepad* gamepad = SDL_OpenGamepad(event.gdevice.which);
-                if (!gamepad) {
-                    LOG_ERROR("SDL_OpenGamepad failed: %s", SDL_GetError());
-                    continue;
-                }
-
-                if (!pad_mount(
-                        event.gdevice.which,
-                        (void*)gamepad,
-                        0,
-                        SDL_GetGamepadVendor(gamepad),
-                        SDL_GetGamepadProduct(gamepad))) {
-                    LOG_ERROR("pad_mount failed for Gamepad %d", event.gdevice.which);
-                    SDL_CloseGamepad(gamepad);
-                }
-            } break;
-            case SDL_EVENT_GAMEPAD_REMOVED: {
-                LOG_INFO("SDL Gamepad %d removed", event.gdevice.which);
-                SDL_CloseGamepad(SDL_GetGamepadFromID(event.gdevice.which));
-                pad_umount(event.gdevice.which);
-            } break;
-
-            case SDL_EVENT_JOYSTICK_UPDATE_COMPLETE:
-            case SDL_EVENT_GAMEPAD_UPDATE_COMPLETE: {
-                // could use this to update force feedback effects
-            } break;
-
-            default: {
-                if (event.type >= SDL_EVENT_JOYSTICK_AXIS_MOTION && event.type < SDL_EVENT_JOYSTICK_UPDATE_COMPLETE) {
-                    // Joystick event
-                    if (SDL_IsGamepad(event.jdevice.which)) continue;
-                    pad_report(
-                        event.jdevice.which,
-                        (const void*)SDL_GetJoystickFromID(event.jdevice.which),
-                        event.type);
-                }
-                else if (
-                    event.type >= SDL_EVENT_GAMEPAD_AXIS_MOTION && event.type < SDL_EVENT_GAMEPAD_UPDATE_COMPLETE) {
-                    // Gamepad event
-                    pad_report(event.jdevice.which, (const void*)SDL_GetGamepadFromID(event.jdevice.which), event.type);
-                }
-                else {
-                    LOG_WARNING("Unhandled SDL event type: 0x%X", event.type)
-                };
-            } break;
-        }
-    }
-}
-
-#include <class/hid/hid.h>
 static uint8_t sokol2usb[] = {
     [SAPP_KEYCODE_SPACE] = HID_KEY_SPACE,
     [SAPP_KEYCODE_APOSTROPHE] = HID_KEY_APOSTROPHE,
@@ -233,26 +136,103 @@ static uint8_t sokol2usb[] = {
     [SAPP_KEYCODE_MENU] = HID_KEY_MENU,
 };
 
-#define KBD_KEY_BIT_SET(data, keycode) (data[keycode >> 5] |= 1 << (keycode & 31))
-#define KBD_KEY_BIT_RES(data, keycode) (data[keycode >> 5] &= ~(1 << (keycode & 31)))
-#define KBD_KEY_BIT_VAL(data, keycode) (data[keycode >> 5] & (1 << (keycode & 31)))
-
-void hid_key_down(sapp_keycode key_code) {
-    if (key_code) {
-        uint8_t usb_keycode = sokol2usb[key_code];
-        if (usb_keycode) {
-            KBD_KEY_BIT_SET(kbd_keys, usb_keycode);
-        }
+uint8_t hid_usb_keycode(sapp_keycode key_code) {
+    if ((key_code < 0) || (key_code >= (int)sizeof(sokol2usb))) {
+        return 0;
     }
-    kbd_report(1, (void*)kbd_keys, 0);
+    return sokol2usb[key_code];
+}
+
+bool sdl_has_events(void) {
+    SDL_PumpEvents();
+    return SDL_HasEvents(SDL_EVENT_FIRST, SDL_EVENT_LAST);
 }
 
-void hid_key_up(sapp_keycode key_code) {
-    if (key_code) {
-        uint8_t usb_keycode = sokol2usb[key_code];
-        if (usb_keycode) {
-            KBD_KEY_BIT_RES(kbd_keys, usb_keycode);
+// SDL3 event handling
+void sdl_poll_events(void) {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        switch (event.type) {
+            case SDL_EVENT_QUIT: {
+                sapp_request_quit();
+            } break;
+
+            case SDL_EVENT_JOYSTICK_ADDED: {
+                if (SDL_IsGamepad(event.jdevice.which)) {
+                    // Let's wait for the gamepad added event
+                    continue;
+                }
+
+                LOG_INFO("SDL Joystick %d added.", event.jdevice.which);
+                SDL_Joystick* joystick = SDL_OpenJoystick(event.jdevice.which);
+                if (!joystick) {
+                    LOG_ERROR("SDL_OpenJoystick failed: %s", SDL_GetError());
+                    continue;
+                }
+
+                if (!pad_mount(
+                        event.jdevice.which,
+                        (void*)joystick,
+                        0,
+                        SDL_GetJoystickVendor(joystick),
+                        SDL_GetJoystickProduct(joystick))) {
+                    LOG_ERROR("pad_mount failed for joystick %d", event.jdevice.which);
+                    SDL_CloseJoystick(joystick);
+                }
+            } break;
+            case SDL_EVENT_JOYSTICK_REMOVED: {
+                if (SDL_IsGamepad(event.jdevice.which)) continue;
+                LOG_INFO("SDL Joystick %d removed", event.jdevice.which);
+                SDL_CloseJoystick(SDL_GetJoystickFromID(event.jdevice.which));
+                pad_umount(event.jdevice.which);
+            } break;
+            case SDL_EVENT_GAMEPAD_ADDED: {
+                LOG_INFO("SDL Gamepad %d added", event.gdevice.which);
+                SDL_Gamepad* gamepad = SDL_OpenGamepad(event.gdevice.which);
+                if (!gamepad) {
+                    LOG_ERROR("SDL_OpenGamepad failed: %s", SDL_GetError());
+                    continue;
+                }
+
+                if (!pad_mount(
+                        event.gdevice.which,
+                        (void*)gamepad,
+                        0,
+                        SDL_GetGamepadVendor(gamepad),
+                        SDL_GetGamepadProduct(gamepad))) {
+                    LOG_ERROR("pad_mount failed for Gamepad %d", event.gdevice.which);
+                    SDL_CloseGamepad(gamepad);
+                }
+            } break;
+            case SDL_EVENT_GAMEPAD_REMOVED: {
+                LOG_INFO("SDL Gamepad %d removed", event.gdevice.which);
+                SDL_CloseGamepad(SDL_GetGamepadFromID(event.gdevice.which));
+                pad_umount(event.gdevice.which);
+            } break;
+
+            case SDL_EVENT_JOYSTICK_UPDATE_COMPLETE:
+            case SDL_EVENT_GAMEPAD_UPDATE_COMPLETE: {
+                // could use this to update force feedback effects
+            } break;
+
+            default: {
+                if (event.type >= SDL_EVENT_JOYSTICK_AXIS_MOTION && event.type < SDL_EVENT_JOYSTICK_UPDATE_COMPLETE) {
+                    // Joystick event
+                    if (SDL_IsGamepad(event.jdevice.which)) continue;
+                    pad_report(
+                        event.jdevice.which,
+                        (const void*)SDL_GetJoystickFromID(event.jdevice.which),
+                        event.type);
+                }
+                else if (
+                    event.type >= SDL_EVENT_GAMEPAD_AXIS_MOTION && event.type < SDL_EVENT_GAMEPAD_UPDATE_COMPLETE) {
+                    // Gamepad event
+                    pad_report(event.jdevice.which, (const void*)SDL_GetGamepadFromID(event.jdevice.which), event.type);
+                }
+                else {
+                    LOG_WARNING("Unhandled SDL event type: 0x%X", event.type)
+                };
+            } break;
         }
     }
-    kbd_report(1, (void*)kbd_keys, 0);
 }
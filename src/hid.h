@@ -4,9 +4,10 @@
 
 void hid_init(void);
 void hid_shutdown(void);
-void hid_reset(void);
 
+// true if SDL has events for sdl_poll_events()
+bool sdl_has_events(void);
 void sdl_poll_events();
 
-void hid_key_down(sapp_keycode key_code);
-void hid_key_up(sapp_keycode key_code);
+// map a sokol key code to the USB HID keyboard usage ID x65_key_down() takes, 0 if unmapped
+uint8_t hid_usb_keycode(sapp_keycode key_code);
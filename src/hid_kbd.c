@@ -0,0 +1,28 @@
+#include "./hid_kbd.h"
+
+#include "north/hid/kbd.h"
+
+#include <string.h>
+
+void hid_reset(uint32_t keys[8]) {
+    memset(keys, 0, 8 * sizeof(uint32_t));
+    hid_key_up(keys, 0);  // fake phantom key up to initialize kbd
+}
+
+#define KBD_KEY_BIT_SET(data, keycode) (data[keycode >> 5] |= 1 << (keycode & 31))
+#define KBD_KEY_BIT_RES(data, keycode) (data[keycode >> 5] &= ~(1 << (keycode & 31)))
+#define KBD_KEY_BIT_VAL(data, keycode) (data[keycode >> 5] & (1 << (keycode & 31)))
+
+void hid_key_down(uint32_t keys[8], uint8_t key_code) {
+    if (key_code) {
+        KBD_KEY_BIT_SET(keys, key_code);
+    }
+    kbd_report(1, (void*)keys, 0);
+}
+
+void hid_key_up(uint32_t keys[8], uint8_t key_code) {
+    if (key_code) {
+        KBD_KEY_BIT_RES(keys, key_code);
+    }
+    kbd_report(1, (void*)keys, 0);
+}
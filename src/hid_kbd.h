@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+// keys is the USB HID key bitmap of a machine, reported to the firmware keyboard
+// driver, key_code a USB HID keyboard usage ID
+void hid_reset(uint32_t keys[8]);
+void hid_key_down(uint32_t keys[8], uint8_t key_code);
+void hid_key_up(uint32_t keys[8], uint8_t key_code);
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "sokol_log.h"
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
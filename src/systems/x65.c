@@ -1,34 +1,65 @@
 #include "./x65.h"
-#include "../args.h"
 #include "../log.h"
-#include "../hid.h"
+#include "../hid_kbd.h"
 
 #include "chips/clk.h"
 
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>  // memcpy, memset
+#include <time.h>
 
 #ifndef CHIPS_ASSERT
     #include <assert.h>
     #define CHIPS_ASSERT(c) assert(c)
 #endif
 
-// declare function to sync RAM writes to CGIA L1 cache
-void cgia_ram_write(uint8_t bank, uint16_t addr, uint8_t data);
-
 static uint8_t _x65_vpu_fetch(uint32_t addr, void* user_data);
 static void _x65_api_call(uint8_t data, void* user_data);
+static uint8_t _x65_step_trap(uint32_t addr, uint8_t data, bool write, uint32_t cycle, void* user_data);
+static uint64_t _x65_step_int(uint32_t cycle, void* user_data);
+static void _x65_sched_sync(x65_t* sys);
+static void _x65_sched_reset(x65_t* sys);
+static void _x65_bus_init(x65_t* sys);
 
 #define _X65_DEFAULT(val, def) (((val) != 0) ? (val) : (def))
 
+// the firmware keeps its state in globals, so there is only one live machine
+static x65_t* _x65_live;
+static x65_log_t _x65_log;
+
+// the chips and the firmware glue log through log_func(), see log.h
+void log_func(uint32_t log_level, const char* log_id, const char* filename, uint32_t line_nr, const char* fmt, ...) {
+    char message[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+
+    if (_x65_log.func) {
+        _x65_log.func(log_level, log_id, filename, line_nr, message, _x65_log.user_data);
+    }
+    else {
+        static const char* level[] = { "panic", "error", "warning", "info" };
+        fprintf(stderr, "[%s] %s: %s\n", level[log_level & 3], log_id, message);
+    }
+}
+
 void x65_init(x65_t* sys, const x65_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
     if (desc->debug.callback.func) {
         CHIPS_ASSERT(desc->debug.stopped);
     }
+    if (_x65_live && (_x65_live != sys)) {
+        LOG_ERROR("Another X65 is live, the machines would share the firmware state");
+        CHIPS_ASSERT(false);
+    }
+    _x65_live = sys;
+    _x65_log = desc->log;
 
     memset(sys, 0, sizeof(x65_t));
-    if (!arguments.zeromem)
+    if (!desc->zeromem)
         for (int i = 0; i < X65_RAM_SIZE_BYTES; i++) {
             sys->ram[i] = rand() & 0xFF;  // fill RAM with random data
         }
@@ -36,13 +67,31 @@ void x65_init(x65_t* sys, const x65_desc_t* desc) {
     sys->valid = true;
     sys->running = false;
     sys->joystick_type = desc->joystick_type;
+    sys->cpu_engine = desc->cpu_engine;
+    if (sys->cpu_engine == X65_CPU_ENGINE_BLOCKS) {
+        sys->blocks = calloc(1, sizeof(x65_blocks_t));
+        CHIPS_ASSERT(sys->blocks);
+    }
     sys->debug = desc->debug;
     sys->audio.callback = desc->audio.callback;
     sys->audio.num_samples = _X65_DEFAULT(desc->audio.num_samples, X65_DEFAULT_AUDIO_SAMPLES) * SGU_AUDIO_CHANNELS;
     CHIPS_ASSERT(sys->audio.num_samples <= X65_MAX_AUDIO_SAMPLES);
 
     // initialize the hardware
-    sys->pins = w65816_init(&sys->cpu, &(w65816_desc_t){});
+    sys->pins = w65816_init(
+        &sys->cpu,
+        &(w65816_desc_t){
+            .step = {
+                .mem = sys->ram,
+                .trap_start = X65_EXT_BASE,
+                .trap_end = 0xFFFF,
+                // RAM writes are mirrored to CGIA, let it catch up first
+                .trap_writes = true,
+                .trap_cb = _x65_step_trap,
+                .int_cb = _x65_step_int,
+                .user_data = sys,
+            },
+        });
     ria816_init(
         &sys->ria,
         &(ria816_desc_t){
@@ -51,6 +100,7 @@ void x65_init(x65_t* sys, const x65_desc_t* desc) {
             .user_data = sys,
         });
     tca6416a_init(&sys->gpio, 0xff, 0xff);
+    _x65_bus_init(sys);
     cgia_init(&sys->cgia, &(cgia_desc_t){
         .tick_hz = X65_FREQUENCY,
         .fetch_cb = _x65_vpu_fetch,
@@ -59,6 +109,11 @@ void x65_init(x65_t* sys, const x65_desc_t* desc) {
             .ptr = sys->fb,
             .size = sizeof(sys->fb),
         },
+        .line_sig = {
+            .ptr = sys->fb_line_sig,
+            .size = sizeof(sys->fb_line_sig),
+        },
+        .dirty = &sys->fb_dirty,
     });
     sgu1_init(
         &sys->sgu,
@@ -74,24 +129,32 @@ void x65_init(x65_t* sys, const x65_desc_t* desc) {
             .base_volume = _X65_DEFAULT(desc->audio.volume, 1.0f),
         });
 
-    hid_reset();
+    hid_reset(sys->kbd_keys);
 }
 
 void x65_discard(x65_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
+    free(sys->blocks);
+    sys->blocks = 0;
     sys->valid = false;
+    if (_x65_live == sys) {
+        _x65_live = 0;
+    }
 }
 
 void x65_reset(x65_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     sys->kbd_joy1_mask = sys->kbd_joy2_mask = 0;
     sys->joy_joy1_mask = sys->joy_joy2_mask = 0;
+    sys->input.num = 0;
     sys->pins |= W65816_RES;
+    _x65_sched_sync(sys);
     ria816_reset(&sys->ria);
     tca6416a_reset(&sys->gpio, 0xff, 0xff);
     cgia_reset(&sys->cgia);
     sgu1_reset(&sys->sgu);
     beeper_reset(&sys->beeper);
+    _x65_sched_reset(sys);
 }
 
 void x65_set_running(x65_t* sys, bool running) {
@@ -99,18 +162,139 @@ void x65_set_running(x65_t* sys, bool running) {
     sys->running = running;
 }
 
-static uint64_t _x65_tick(x65_t* sys, uint64_t pins) {
-    if (!sys->running) {
-        // keep CPU in RESET state
-        pins |= W65816_RES;
+void x65_set_warp(x65_t* sys, bool warp) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->warp = warp;
+    sys->cgia.fb_skip = warp;
+}
+
+void x65_set_frame_skip(x65_t* sys, bool enable) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->frame_skip.enabled = enable;
+    sys->frame_skip.load = 0.0f;
+    sys->cgia.frame_skip = 0;
+}
+
+void x65_adapt_frame_skip(x65_t* sys, uint32_t micro_seconds, uint32_t host_micro_seconds) {
+    CHIPS_ASSERT(sys && sys->valid);
+    if (!sys->frame_skip.enabled || (0 == micro_seconds)) {
+        return;
+    }
+    // the load alternates between rasterized and skipped frames, smooth it,
+    // the thresholds are far enough apart for one level to not flip-flop
+    const float load = (float)host_micro_seconds / (float)micro_seconds;
+    sys->frame_skip.load += (load - sys->frame_skip.load) * 0.1f;
+    if ((sys->frame_skip.load > 0.9f) && (sys->cgia.frame_skip < X65_MAX_FRAME_SKIP)) {
+        sys->cgia.frame_skip++;
+        sys->frame_skip.load = 0.65f;
     }
+    else if ((sys->frame_skip.load < 0.4f) && (sys->cgia.frame_skip > 0)) {
+        sys->cgia.frame_skip--;
+        sys->frame_skip.load = 0.65f;
+    }
+}
 
-    // tick the CPU
-    pins = w65816_tick(&sys->cpu, pins);
-    const uint32_t addr = W65816_GET_ADDR(pins) & 0xFFFFFF;
+// rebuild the bank 0 page table after RIA816_EXT_IO changed
+static void _x65_bus_update(x65_t* sys) {
+    sys->bus.ext_io = sys->ria.reg[RIA816_EXT_IO];
+    sys->bus.page[X65_EXT_BASE >> 8] = sys->bus.ext_io ? X65_BUS_EXT : X65_BUS_RAM;
+}
 
-    // those pins are set each tick by the CIAs and VIC
-    pins &= ~(W65816_IRQ | W65816_NMI | W65816_RDY);
+// build the address decoder tables
+static void _x65_bus_init(x65_t* sys) {
+    memset(sys->bus.page, X65_BUS_RAM, sizeof(sys->bus.page));
+    for (uint32_t addr = X65_IO_BASE; addr <= 0xFFFF; addr++) {
+        x65_bus_dev_t dev = X65_DEV_NONE;
+        if (addr >= X65_IO_RIA_BASE) {
+            dev = X65_DEV_RIA;
+        }
+        else if (addr >= X65_IO_HID_BASE) {
+            dev = X65_DEV_HID;
+        }
+        else if (addr >= 0xFFAC) {
+            dev = X65_DEV_UNUSED;
+        }
+        else if (addr >= X65_IO_BUZZER_BASE) {
+            dev = X65_DEV_BUZZER;
+        }
+        else if (addr >= X65_IO_RGB_BASE) {
+            dev = X65_DEV_RGB;
+        }
+        else if (addr >= X65_IO_TIMERS_BASE) {
+            dev = X65_DEV_TIMERS;
+        }
+        else if (addr >= X65_IO_GPIO_BASE) {
+            dev = X65_DEV_GPIO;
+        }
+        else if (addr >= X65_IO_CGIA_BASE) {
+            dev = X65_DEV_CGIA;
+        }
+        else if (addr >= X65_IO_SGU_BASE) {
+            dev = X65_DEV_SGU;
+        }
+        else if (addr >= X65_IO_MIXER_BASE) {
+            dev = X65_DEV_MIXER;
+        }
+        sys->bus.io[addr & (X65_IO_LEN - 1)] = (uint8_t)dev;
+        sys->bus.page[addr >> 8] = X65_BUS_IO;
+    }
+    _x65_bus_update(sys);
+}
+
+// skip the ticks of a chip since it last ran
+static void _x65_sched_skip(x65_t* sys, x65_sched_chip_t chip) {
+    const uint32_t num_ticks = (uint32_t)(sys->sched.now - sys->sched.synced[chip]);
+    if (num_ticks > 0) {
+        switch (chip) {
+            case X65_SCHED_RIA: ria816_skip_ticks(&sys->ria, num_ticks); break;
+            case X65_SCHED_CGIA: cgia_skip_ticks(&sys->cgia, num_ticks); break;
+            case X65_SCHED_SGU: sgu1_skip_ticks(&sys->sgu, num_ticks); break;
+            default: break;  // the GPIO extender only changes when its inputs do
+        }
+        sys->sched.synced[chip] = sys->sched.now;
+    }
+}
+
+// does a chip run in the current tick? catches up its skipped ticks if so
+static inline bool _x65_sched_due(x65_t* sys, x65_sched_chip_t chip, bool selected) {
+    if (!selected && (sys->sched.deadline[chip] != sys->sched.now)) {
+        return false;
+    }
+    _x65_sched_skip(sys, chip);
+    return true;
+}
+
+// a chip ran in the current tick, set its next deadline
+static inline void _x65_sched_done(x65_t* sys, x65_sched_chip_t chip, uint32_t idle_ticks) {
+    sys->sched.synced[chip] = sys->sched.now + 1;
+    sys->sched.deadline[chip] = sys->sched.now + 1 + idle_ticks;
+}
+
+// bring all chips up to the current tick
+static void _x65_sched_sync(x65_t* sys) {
+    for (int chip = 0; chip < X65_SCHED_NUM; chip++) {
+        _x65_sched_skip(sys, (x65_sched_chip_t)chip);
+    }
+}
+
+// let all chips run in the next tick
+static void _x65_sched_reset(x65_t* sys) {
+    for (int chip = 0; chip < X65_SCHED_NUM; chip++) {
+        sys->sched.synced[chip] = sys->sched.deadline[chip] = sys->sched.now;
+    }
+    sys->sched.next = sys->sched.now;
+}
+
+static uint64_t _x65_prof_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// tick the chips and perform the CPU bus access of one clock cycle, only
+// the chips which are selected or at their deadline actually run
+static uint64_t _x65_tick_bus(x65_t* sys, uint64_t pins) {
+    const uint32_t addr = W65816_GET_ADDR(pins) & 0xFFFFFF;
 
     /*  address decoding
 
@@ -123,63 +307,36 @@ static uint64_t _x65_tick(x65_t* sys, uint64_t pins) {
     uint64_t gpio_pins = pins & W65816_PIN_MASK;
     uint64_t sgu_pins = pins & W65816_PIN_MASK;
     if ((pins & (W65816_RDY | W65816_RW)) != (W65816_RDY | W65816_RW)) {
-        if (sys->ria.reg[RIA816_EXT_IO] && ((addr & 0xFF00) == X65_EXT_BASE)) {
-            const uint8_t slot = (addr & 0xFF) >> 5;
-            if ((sys->ria.reg[RIA816_EXT_IO] & (1U << slot))) switch (slot) {
-                    case 0x00: {
-                        // OPL-3 (FC00..FC1F)
-                        // opl3_pins |= YMF262_CS;
-                    } break;
-                    default:
-                        if (pins & W65816_RW) {
-                            // memory read nothin'
-                            W65816_SET_DATA(pins, 0xFF);
-                        }
+        switch ((addr > 0xFFFF) ? X65_BUS_RAM : sys->bus.page[addr >> 8]) {
+            case X65_BUS_RAM: mem_access = true; break;
+            case X65_BUS_EXT: {
+                const uint8_t slot = (addr & 0xFF) >> 5;
+                if ((sys->bus.ext_io & (1U << slot))) switch (slot) {
+                        case 0x00: {
+                            // OPL-3 (FC00..FC1F)
+                            // opl3_pins |= YMF262_CS;
+                        } break;
+                        default:
+                            if (pins & W65816_RW) {
+                                // memory read nothin'
+                                W65816_SET_DATA(pins, 0xFF);
+                            }
+                    }
+            } break;
+            case X65_BUS_IO:
+                switch (sys->bus.io[addr & (X65_IO_LEN - 1)]) {
+                    case X65_DEV_RIA: ria_pins |= RIA816_CS; break;
+                    case X65_DEV_HID: ria_pins |= RIA816_HID_CS; break;
+                    case X65_DEV_BUZZER: ria_pins |= RIA816_BUZZER_CS; break;
+                    case X65_DEV_RGB: ria_pins |= RIA816_RGB_CS; break;
+                    case X65_DEV_TIMERS: ria_pins |= RIA816_TIMERS_CS; break;
+                    case X65_DEV_GPIO: gpio_pins |= TCA6416A_CS; break;
+                    case X65_DEV_CGIA: cgia_pins |= CGIA_CS; break;
+                    case X65_DEV_SGU: sgu_pins |= SGU1_CS; break;
+                    case X65_DEV_MIXER: break;  // FIXME: MIXER_CS;
+                    default: break;
                 }
-        }
-        else if ((addr & X65_IO_BASE) == X65_IO_BASE) {
-            if (addr >= X65_IO_RIA_BASE) {
-                // RIA (FFC0..FFFF)
-                ria_pins |= RIA816_CS;
-            }
-            else if (addr >= X65_IO_HID_BASE) {
-                // GPIO (FFB0..FFBF)
-                ria_pins |= RIA816_HID_CS;
-            }
-            else if (addr >= 0xFFAC) {
-                // NOT_USED (FFAC..FFAF)
-            }
-            else if (addr >= X65_IO_BUZZER_BASE) {
-                // GPIO (FFA8..FFAB)
-                ria_pins |= RIA816_BUZZER_CS;
-            }
-            else if (addr >= X65_IO_RGB_BASE) {
-                // GPIO (FFA0..FFA7)
-                ria_pins |= RIA816_RGB_CS;
-            }
-            else if (addr >= X65_IO_TIMERS_BASE) {
-                // GPIO (FF98..FF9F)
-                ria_pins |= RIA816_TIMERS_CS;
-            }
-            else if (addr >= X65_IO_GPIO_BASE) {
-                // GPIO (FF80..FF97)
-                gpio_pins |= TCA6416A_CS;
-            }
-            else if (addr >= X65_IO_CGIA_BASE) {
-                // CGIA (FF00..FF7F)
-                cgia_pins |= CGIA_CS;
-            }
-            else if (addr >= X65_IO_SGU_BASE) {
-                // SID (FEC0..FEFF)
-                sgu_pins |= SGU1_CS;
-            }
-            else if (addr >= X65_IO_MIXER_BASE) {
-                // MIXER (FEB0..FEBF)
-                // FIXME: MIXER_CS;
-            }
-        }
-        else {
-            mem_access = true;
+                break;
         }
     }
 
@@ -191,11 +348,13 @@ static uint64_t _x65_tick(x65_t* sys, uint64_t pins) {
 
         INT pin is connected to the Interrupt Controller pin 1
     */
-    {
+    if (_x65_sched_due(sys, X65_SCHED_GPIO, gpio_pins & TCA6416A_CS)) {
         const uint8_t p0 = ~(sys->kbd_joy1_mask | sys->joy_joy1_mask);
         const uint8_t p1 = ~(sys->kbd_joy2_mask | sys->joy_joy2_mask);
         TCA6416A_SET_P01(gpio_pins, p0, p1);
         gpio_pins = tca6416a_tick(&sys->gpio, gpio_pins);
+        // unchanged inputs don't change anything, a register write may
+        _x65_sched_done(sys, X65_SCHED_GPIO, (gpio_pins & TCA6416A_CS) ? 0 : UINT32_MAX);
         if (gpio_pins & TCA6416A_INT) {
             sys->ria.int_status |= X65_INT_GPIO;
         }
@@ -209,8 +368,13 @@ static uint64_t _x65_tick(x65_t* sys, uint64_t pins) {
 
     /* tick RIA816:
      */
-    {
+    const uint64_t ria_cs = RIA816_CS | RIA816_HID_CS | RIA816_RGB_CS | RIA816_TIMERS_CS;
+    if (_x65_sched_due(sys, X65_SCHED_RIA, ria_pins & ria_cs)) {
         ria_pins = ria816_tick(&sys->ria, ria_pins);
+        _x65_sched_done(sys, X65_SCHED_RIA, ria816_idle_ticks(&sys->ria));
+        if ((ria_pins & RIA816_CS) && (sys->ria.reg[RIA816_EXT_IO] != sys->bus.ext_io)) {
+            _x65_bus_update(sys);
+        }
         if ((ria_pins & (RIA816_CS | RIA816_RW)) == (RIA816_CS | RIA816_RW)) {
             pins = W65816_COPY_DATA(pins, ria_pins);
         }
@@ -224,25 +388,35 @@ static uint64_t _x65_tick(x65_t* sys, uint64_t pins) {
 
     /* tick the CGIA display chip:
      */
-    {
+    if (_x65_sched_due(sys, X65_SCHED_CGIA, cgia_pins & CGIA_CS)) {
+        const uint64_t prof_start = sys->prof.enabled ? _x65_prof_now() : 0;
         cgia_pins = cgia_tick(&sys->cgia, cgia_pins);
-        if (cgia_pins & CGIA_INT) {
-            pins |= W65816_NMI;
+        if (sys->prof.enabled) {
+            sys->prof.cgia_ns += _x65_prof_now() - prof_start;
         }
+        _x65_sched_done(sys, X65_SCHED_CGIA, cgia_idle_ticks(&sys->cgia));
         if ((cgia_pins & (CGIA_CS | CGIA_RW)) == (CGIA_CS | CGIA_RW)) {
             pins = W65816_COPY_DATA(pins, cgia_pins);
         }
     }
+    if (sys->cgia.pins & CGIA_INT) {
+        pins |= W65816_NMI;
+    }
 
     // tick the SGU
-    {
+    if (_x65_sched_due(sys, X65_SCHED_SGU, sgu_pins & SGU1_CS)) {
+        const uint64_t prof_start = sys->prof.enabled ? _x65_prof_now() : 0;
         sgu_pins = sgu1_tick(&sys->sgu, sgu_pins);
+        if (sys->prof.enabled) {
+            sys->prof.sgu_ns += _x65_prof_now() - prof_start;
+        }
+        _x65_sched_done(sys, X65_SCHED_SGU, sgu1_idle_ticks(&sys->sgu));
         if (sgu_pins & SGU1_SAMPLE) {
             // new audio sample ready
             sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->sgu.sample[0];
             sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->sgu.sample[1];
             if (sys->audio.sample_pos == sys->audio.num_samples) {
-                if (sys->audio.callback.func) {
+                if (sys->audio.callback.func && !sys->warp) {
                     sys->audio.callback.func(
                         sys->audio.sample_buffer,
                         sys->audio.num_samples,
@@ -277,124 +451,719 @@ static uint64_t _x65_tick(x65_t* sys, uint64_t pins) {
             mem_ram_write(sys, addr, W65816_GET_DATA(pins));
         }
     }
+
+    // the next tick which needs any chip
+    sys->sched.now++;
+    sys->sched.next = sys->sched.deadline[0];
+    for (int chip = 1; chip < X65_SCHED_NUM; chip++) {
+        if (sys->sched.deadline[chip] < sys->sched.next) {
+            sys->sched.next = sys->sched.deadline[chip];
+        }
+    }
     return pins;
 }
 
-uint8_t mem_rd(x65_t* sys, uint8_t bank, uint16_t addr) {
-    if (bank == 0) {
-        if (addr >= X65_IO_RIA_BASE) {
-            const uint8_t reg = addr & RIA816_RS;
-            switch (reg) {
-                case RIA816_FS_FDARW:
-                case RIA816_FS_FDBRW:
-                case RIA816_UART_TX_RX:
-                case RIA816_API_STACK: return 0xFF;
-            }
-            return ria816_reg_read(&sys->ria, reg);
+// tick the chips without CPU bus access, return the IRQ/NMI pins after the
+// last tick; only the ticks at chip deadlines actually run
+static uint64_t _x65_tick_idle(x65_t* sys, uint32_t num_ticks) {
+    const uint64_t end = sys->sched.now + num_ticks;
+    while (sys->sched.next < end) {
+        sys->sched.now = sys->sched.next;
+        // an active RDY read cycle keeps the chips off the bus
+        _x65_tick_bus(sys, W65816_RDY | W65816_RW);
+    }
+    sys->sched.now = end;
+    return (sys->ria.int_status ? W65816_IRQ : 0) | ((sys->cgia.pins & CGIA_INT) ? W65816_NMI : 0);
+}
+
+// number of ticks up to and including the next chip deadline, at most 'num_ticks'
+static uint32_t _x65_sched_ticks(x65_t* sys, uint32_t num_ticks) {
+    const uint64_t ticks = sys->sched.next - sys->sched.now + 1;
+    return (ticks < num_ticks) ? (uint32_t)ticks : num_ticks;
+}
+
+static uint64_t _x65_tick(x65_t* sys, uint64_t pins) {
+    if (!sys->running) {
+        // keep CPU in RESET state, like _x65_idle() it does nothing until
+        // released and only the chips are ticked
+        return (pins & ~(W65816_IRQ | W65816_NMI | W65816_RDY)) | _x65_tick_idle(sys, 1) | W65816_RES;
+    }
+
+    // tick the CPU
+    pins = w65816_tick(&sys->cpu, pins);
+
+    // those pins are set each tick by the CIAs and VIC
+    pins &= ~(W65816_IRQ | W65816_NMI | W65816_RDY);
+
+    return _x65_tick_bus(sys, pins);
+}
+
+// spin loop detection states and flags of recorded ticks
+#define _X65_SPIN_IDLE      (0)
+#define _X65_SPIN_RECORDING (1)  // recording an iteration starting at the loop head
+#define _X65_SPIN_SPINNING  (2)  // the recorded iteration returned to the loop head state
+#define _X65_SPIN_READ      (1 << 0)  // tick is a trapped read
+#define _X65_SPIN_BOUNDARY  (1 << 1)  // last tick of an instruction
+#define _X65_SPIN_IRQ       (1 << 2)  // IRQ pin after the tick
+#define _X65_SPIN_NMI       (1 << 3)  // NMI pin after the tick
+
+static uint8_t _x65_spin_int_flags(uint64_t int_pins) {
+    return ((int_pins & W65816_IRQ) ? _X65_SPIN_IRQ : 0) | ((int_pins & W65816_NMI) ? _X65_SPIN_NMI : 0);
+}
+
+static uint64_t _x65_spin_int_pins(uint8_t flags) {
+    return ((flags & _X65_SPIN_IRQ) ? W65816_IRQ : 0) | ((flags & _X65_SPIN_NMI) ? W65816_NMI : 0);
+}
+
+// record a chip tick of the current spin loop iteration
+static void _x65_spin_record(x65_t* sys, uint16_t addr, uint8_t data, uint8_t flags) {
+    if (sys->spin.state == _X65_SPIN_RECORDING) {
+        if (sys->spin.num_ticks < X65_SPIN_MAX_TICKS) {
+            sys->spin.tick[sys->spin.num_ticks].addr = addr;
+            sys->spin.tick[sys->spin.num_ticks].data = data;
+            sys->spin.tick[sys->spin.num_ticks].flags = flags | _x65_spin_int_flags(sys->step.int_pins);
+            sys->spin.num_ticks++;
         }
-        else if (addr >= X65_IO_HID_BASE) {
-            return ria816_hid_read(&sys->ria, addr & RIA816_HID_RS);
+        else {
+            sys->spin.state = _X65_SPIN_IDLE;
         }
-        else if (addr >= 0xFFAC) {
-            // NOT_USED (FFAC..FFAF)
-            return 0xFF;
+    }
+}
+
+// tick the chips without CPU bus access up to a tick of the current instruction
+static void _x65_step_catch_up(x65_t* sys, uint32_t ticks) {
+    while (sys->step.ticks < ticks) {
+        if (sys->spin.pos < sys->spin.ahead) {
+            // already done by an interrupted spin loop fast-forward
+            sys->step.int_pins = _x65_spin_int_pins(sys->spin.replay[sys->spin.pos++].flags);
         }
-        else if (addr >= X65_IO_BUZZER_BASE) {
-            return 0xFF;
+        else if (sys->spin.state != _X65_SPIN_RECORDING) {
+            sys->step.int_pins = _x65_tick_idle(sys, ticks - sys->step.ticks);
+            sys->step.ticks = ticks;
+            break;
         }
-        else if (addr >= X65_IO_RGB_BASE) {
-            return ria816_rgb_read(&sys->ria, addr & RIA816_HID_RS);
+        else {
+            sys->step.int_pins = _x65_tick_idle(sys, 1);
         }
-        else if (addr >= X65_IO_TIMERS_BASE) {
-            const uint8_t reg = addr & RIA816_TIMERS_RS;
-            switch (reg) {
-                case M6526_REG_ICR: return sys->ria.cia.intr.icr;
-            }
-            return m6526_read(&sys->ria.cia, reg);
+        sys->step.ticks++;
+        _x65_spin_record(sys, 0, 0, 0);
+    }
+}
+
+// the chips only change the interrupt pins in ticks in which they run, let
+// the CPU pick them up after the next such tick of the current instruction
+static void _x65_step_int_next(x65_t* sys) {
+    // ticks replayed from a cut short spin loop fast-forward may differ in each tick
+    const uint64_t ticks = (sys->spin.pos < sys->spin.ahead) ? 1 : sys->sched.next - sys->sched.now + 1;
+    sys->cpu.step.int_cycle = (ticks < UINT32_MAX - sys->step.ticks) ? sys->step.ticks + (uint32_t)ticks : UINT32_MAX;
+}
+
+// start an instruction of the stepped CPU
+static void _x65_step_begin(x65_t* sys) {
+    sys->step.ticks = 0;
+    _x65_step_int_next(sys);
+}
+
+// interrupt pins of the instruction-stepped CPU after a tick of the current instruction
+static uint64_t _x65_step_int(uint32_t cycle, void* user_data) {
+    x65_t* sys = (x65_t*)user_data;
+    _x65_step_catch_up(sys, cycle);
+    _x65_step_int_next(sys);
+    return sys->step.int_pins;
+}
+
+// memory trap of instruction-stepped CPU, this is where the chips catch up
+static uint8_t _x65_step_trap(uint32_t addr, uint8_t data, bool write, uint32_t cycle, void* user_data) {
+    x65_t* sys = (x65_t*)user_data;
+    _x65_step_catch_up(sys, cycle);
+    if (write) {
+        // a loop which writes isn't a spin loop
+        sys->spin.state = _X65_SPIN_IDLE;
+    }
+    if (sys->spin.pos < sys->spin.ahead) {
+        CHIPS_ASSERT(!write && (sys->spin.replay[sys->spin.pos].flags & _X65_SPIN_READ));
+        data = sys->spin.replay[sys->spin.pos].data;
+        sys->step.int_pins = _x65_spin_int_pins(sys->spin.replay[sys->spin.pos++].flags);
+    }
+    else {
+        uint64_t pins = W65816_MAKE_PINS(write ? 0 : W65816_RW, (uint64_t)addr, data);
+        pins = _x65_tick_bus(sys, pins);
+        sys->step.int_pins = pins & (W65816_IRQ | W65816_NMI);
+        data = W65816_GET_DATA(pins);
+    }
+    sys->step.ticks++;
+    _x65_spin_record(sys, (uint16_t)addr, data, _X65_SPIN_READ);
+    // the access may have changed the interrupt pins
+    sys->cpu.step.int_cycle = sys->step.ticks;
+    return data;
+}
+
+// has the CPU returned to the recorded state at the spin loop head?
+static bool _x65_spin_at_head(x65_t* sys) {
+    const w65816_t* a = &sys->cpu;
+    const w65816_t* b = &sys->spin.cpu;
+    return sys->running && (sys->pins == sys->spin.pins) && (a->IR == b->IR) && (a->PC == b->PC) && (a->AD == b->AD) &&
+           (a->DO == b->DO) && (a->C == b->C) && (a->X == b->X) && (a->Y == b->Y) && (a->DBR == b->DBR) &&
+           (a->PBR == b->PBR) && (a->D == b->D) && (a->P == b->P) && (a->S == b->S) && (a->PINS == b->PINS) &&
+           (a->irq_pip == b->irq_pip) && (a->nmi_pip == b->nmi_pip) && (a->emulation == b->emulation) &&
+           (a->brk_flags == b->brk_flags) && (a->stopped == b->stopped);
+}
+
+// start recording a spin loop iteration at the current instruction
+static void _x65_spin_start(x65_t* sys) {
+    sys->spin.state = _X65_SPIN_RECORDING;
+    sys->spin.head = W65816_GET_ADDR(sys->pins);
+    sys->spin.pins = sys->pins;
+    sys->spin.cpu = sys->cpu;
+    sys->spin.num_ticks = 0;
+}
+
+// check for a spin loop after an instruction starting at 'pc'; a short
+// backward jump starts recording an iteration, which is a spin loop if it
+// returns to the same CPU state without writing anything
+static void _x65_spin_check(x65_t* sys, uint32_t pc) {
+    const uint32_t addr = W65816_GET_ADDR(sys->pins);
+    if (sys->spin.state == _X65_SPIN_RECORDING) {
+        if (sys->spin.num_ticks > 0) {
+            sys->spin.tick[sys->spin.num_ticks - 1].flags |= _X65_SPIN_BOUNDARY;
         }
-        else if (addr >= X65_IO_GPIO_BASE) {
-            const uint8_t reg = addr & TCA6416A_RS;
-            switch (reg) {
-                case TCA6416A_REG_IN0: return sys->gpio.p0.in;
-                case TCA6416A_REG_IN1: return sys->gpio.p1.in;
+        if (addr == sys->spin.head) {
+            if (_x65_spin_at_head(sys)) {
+                sys->spin.state = _X65_SPIN_SPINNING;
+            }
+            else {
+                _x65_spin_start(sys);
             }
-            return tca6416a_read(&sys->gpio, reg);
+            return;
         }
-        else if (addr >= X65_IO_CGIA_BASE) {
-            return cgia_reg_read((uint8_t)addr);
+    }
+    if ((addr < pc) && ((pc - addr) <= X65_SPIN_MAX_BYTES) && ((addr >> 16) == (pc >> 16))) {
+        _x65_spin_start(sys);
+    }
+}
+
+// fast-forward a detected spin loop by only ticking the chips through the
+// recorded iterations, as long as each trapped read returns the same data
+// and the interrupt pins at each instruction end are unchanged; if a tick
+// differs, the CPU replays the ticks done so far and continues from there;
+// once an iteration repeated, the iterations which end before the next chip
+// deadline are skipped at once, the chips skip those ticks when they run next,
+// returns number of ticks of the skipped iterations
+static uint32_t _x65_spin_fast_forward(x65_t* sys, uint32_t num_ticks) {
+    if (!_x65_spin_at_head(sys)) {
+        sys->spin.state = _X65_SPIN_IDLE;
+        return 0;
+    }
+    uint32_t ticks = 0;
+    bool repeated = false;
+    while (ticks < num_ticks) {
+        if (repeated) {
+            const uint64_t end = sys->sched.now + (num_ticks - ticks);
+            const uint64_t until = (sys->sched.next < end) ? sys->sched.next : end;
+            if (until > sys->sched.now) {
+                const uint32_t n = (uint32_t)((until - sys->sched.now) / sys->spin.num_ticks) * sys->spin.num_ticks;
+                sys->sched.now += n;
+                ticks += n;
+                if (ticks >= num_ticks) {
+                    break;
+                }
+            }
         }
-        else if (addr >= X65_IO_SGU_BASE) {
-            return sgu1_reg_read(&sys->sgu, addr & SGU1_ADDR_MASK);
+        for (uint32_t i = 0; i < sys->spin.num_ticks; i++) {
+            const uint8_t flags = sys->spin.tick[i].flags;
+            uint64_t pins;
+            if (flags & _X65_SPIN_READ) {
+                pins = _x65_tick_bus(sys, W65816_MAKE_PINS(W65816_RW, (uint64_t)sys->spin.tick[i].addr, 0));
+            }
+            else {
+                pins = _x65_tick_bus(sys, W65816_RDY | W65816_RW);
+            }
+            sys->spin.replay[i].data = W65816_GET_DATA(pins);
+            sys->spin.replay[i].flags = (flags & _X65_SPIN_READ) | _x65_spin_int_flags(pins);
+            const uint8_t mask = (flags & _X65_SPIN_BOUNDARY) ? (_X65_SPIN_IRQ | _X65_SPIN_NMI) : 0;
+            if (((flags & _X65_SPIN_READ) && (sys->spin.replay[i].data != sys->spin.tick[i].data)) ||
+                ((sys->spin.replay[i].flags ^ flags) & mask)) {
+                // the loop would take a different path, let the CPU catch up
+                sys->spin.state = _X65_SPIN_IDLE;
+                sys->spin.ahead = i + 1;
+                sys->spin.pos = 0;
+                return ticks;
+            }
         }
+        ticks += sys->spin.num_ticks;
+        repeated = true;
     }
-    // else
-    return sys->ram[(bank << 16) | addr];
+    return ticks;
 }
-void mem_wr(x65_t* sys, uint8_t bank, uint16_t addr, uint8_t data) {
-    if (bank == 0) {
-        if (addr >= X65_IO_RIA_BASE) {
-            ria816_reg_write(&sys->ria, addr & RIA816_RS, data);
-            return;
+
+// finish a stepped CPU instruction, return number of ticks
+static uint32_t _x65_step_done(x65_t* sys, uint32_t pc, uint64_t pins, uint32_t ticks) {
+    _x65_step_catch_up(sys, ticks);
+    sys->pins = (pins & ~(W65816_IRQ | W65816_NMI | W65816_RDY)) | sys->step.int_pins;
+    if (sys->spin.pos == sys->spin.ahead) {
+        sys->spin.pos = sys->spin.ahead = 0;
+    }
+    _x65_spin_check(sys, pc);
+    return ticks;
+}
+
+// run one instruction decoded by w65816_decode(), return number of ticks
+static uint32_t _x65_step_op(x65_t* sys, w65816_op_t op) {
+    uint64_t pins = sys->pins;
+    const uint32_t pc = W65816_GET_ADDR(pins);
+    _x65_step_begin(sys);
+    const uint32_t ticks = w65816_step_op(&sys->cpu, &pins, op);
+    return _x65_step_done(sys, pc, pins, ticks);
+}
+
+// decode the next CPU instruction, 0 if it needs the full _x65_step()
+static w65816_op_t _x65_decode(x65_t* sys) {
+    return sys->running ? w65816_decode(&sys->cpu, sys->pins) : 0;
+}
+
+// run one CPU instruction and the chips alongside, return number of ticks
+static uint32_t _x65_step(x65_t* sys) {
+    const w65816_op_t op = _x65_decode(sys);
+    if (op) {
+        return _x65_step_op(sys, op);
+    }
+    // interrupts, reset and single ticks outside of instructions
+    sys->spin.state = _X65_SPIN_IDLE;
+    uint64_t pins = sys->pins;
+    if (!sys->running) {
+        // keep CPU in RESET state
+        pins |= W65816_RES;
+    }
+    _x65_step_begin(sys);
+    const uint32_t ticks = w65816_step(&sys->cpu, &pins);
+    _x65_step_catch_up(sys, ticks);
+    sys->pins = (pins & ~(W65816_IRQ | W65816_NMI | W65816_RDY)) | sys->step.int_pins;
+    return ticks;
+}
+
+// the CPU is held in RESET or parked in WAI/STP, only tick the chips until
+// the running state changes or an interrupt wakes up the CPU, return number
+// of ticks or 0 if the CPU needs to be stepped
+static uint32_t _x65_idle(x65_t* sys, uint32_t num_ticks) {
+    uint32_t ticks = 0;
+    sys->spin.state = _X65_SPIN_IDLE;
+    if (!sys->running) {
+        // the CPU does nothing until released from RESET, which only
+        // happens in a chip tick
+        while ((ticks < num_ticks) && !sys->running) {
+            const uint32_t n = _x65_sched_ticks(sys, num_ticks - ticks);
+            sys->step.int_pins = _x65_tick_idle(sys, n);
+            ticks += n;
         }
-        else if (addr >= X65_IO_HID_BASE) {
-            ria816_hid_write(&sys->ria, addr & RIA816_HID_RS, data);
-            return;
+        sys->pins = (sys->pins & ~(W65816_IRQ | W65816_NMI)) | sys->step.int_pins | W65816_RES;
+        return ticks;
+    }
+    // a stopped CPU repeats the read of its last tick, only WAI wakes up on interrupts
+    const uint64_t wake = (sys->cpu.stopped == W65816_STOP_WAI) ? (W65816_IRQ | W65816_NMI) : 0;
+    uint64_t pins = sys->pins;
+    CHIPS_ASSERT(pins & W65816_RW);
+    const uint32_t addr = W65816_GET_ADDR(pins);
+    const bool trap = (addr - sys->cpu.step.trap_start) <= sys->cpu.step.trap_span;
+    if (!trap) {
+        W65816_SET_DATA(pins, sys->ram[addr]);
+    }
+    while ((ticks < num_ticks) && sys->running && !(pins & wake)) {
+        if (trap) {
+            pins = _x65_tick_bus(sys, pins & ~(W65816_IRQ | W65816_NMI | W65816_RDY));
+            ticks++;
         }
-        else if (addr >= X65_IO_BUZZER_BASE) {
-            return;
+        else {
+            // interrupts only change at a chip deadline
+            const uint32_t n = _x65_sched_ticks(sys, num_ticks - ticks);
+            pins = (pins & ~(W65816_IRQ | W65816_NMI)) | _x65_tick_idle(sys, n);
+            ticks += n;
         }
-        else if (addr >= X65_IO_RGB_BASE) {
-            ria816_rgb_write(&sys->ria, addr & RIA816_RGB_RS, data);
-            return;
+    }
+    sys->pins = pins;
+    return ticks;
+}
+
+// drop all cached basic blocks
+static void _x65_blocks_flush(x65_blocks_t* blocks) {
+    if (blocks) {
+        memset(blocks, 0, sizeof(*blocks));
+    }
+}
+
+// invalidate the cached blocks of a written code page
+static inline void _x65_blocks_invalidate(x65_blocks_t* blocks, uint32_t page) {
+    if (blocks->code_pages[page >> 5] & (1U << (page & 31))) {
+        blocks->code_pages[page >> 5] &= ~(1U << (page & 31));
+        blocks->page_gen[page]++;
+    }
+}
+
+// can the instruction at the current address be run from a cached block?
+static inline bool _x65_block_ready(x65_t* sys) {
+    return sys->running && w65816_op_ready(&sys->cpu, sys->pins);
+}
+
+// run a basic block from the block cache, recording it on a miss, return
+// number of ticks; a block is only entered with the M/X/E state it was
+// recorded with and its handlers are trusted as long as its code page isn't
+// written, between the instructions only interrupts can cut it short
+static uint32_t _x65_step_block(x65_t* sys, uint32_t num_ticks) {
+    const uint32_t addr = W65816_GET_ADDR(sys->pins);
+    // the trapped IO area doesn't go through mem_ram_write(), don't cache code there
+    const bool trapped = (addr - sys->cpu.step.trap_start) <= sys->cpu.step.trap_span;
+    if (trapped || !_x65_block_ready(sys)) {
+        return _x65_step(sys);
+    }
+    x65_blocks_t* blocks = sys->blocks;
+    const uint32_t page = addr >> 8;
+    const uint8_t table = (uint8_t)w65816_decoder_table(&sys->cpu);
+    x65_block_t* blk = &blocks->block[(addr ^ (addr >> 12)) & (X65_BLOCK_CACHE_SIZE - 1)];
+    uint32_t ticks = 0;
+    if ((blk->addr == addr) && (blk->num_ops > 0) && (blk->gen == blocks->page_gen[page]) && (blk->table == table)) {
+        // replay the cached block
+        ticks = _x65_step_op(sys, blk->op[0]);
+        for (int i = 1; (i < blk->num_ops) && (ticks < num_ticks); i++) {
+            if ((blk->gen != blocks->page_gen[page]) || !_x65_block_ready(sys)) {
+                break;
+            }
+            ticks += _x65_step_op(sys, blk->op[i]);
         }
-        else if (addr >= X65_IO_GPIO_BASE) {
-            return;
+    }
+    else {
+        // record a new block up to a branch, a decoder table switch or the end of the code page
+        blk->addr = addr;
+        blk->gen = blocks->page_gen[page];
+        blk->table = table;
+        blk->num_ops = 0;
+        blocks->code_pages[page >> 5] |= 1U << (page & 31);
+        w65816_op_t op = w65816_decode(&sys->cpu, sys->pins);
+        while (op) {
+            const uint8_t opcode = W65816_GET_DATA(sys->pins);
+            blk->op[blk->num_ops++] = op;
+            ticks += _x65_step_op(sys, op);
+            if (w65816_ends_block(opcode) || (blk->num_ops == X65_BLOCK_MAX_OPS)) {
+                break;
+            }
+            if ((ticks >= num_ticks) || (blk->gen != blocks->page_gen[page])) {
+                // out of ticks or the block wrote its own code page, don't keep it
+                blk->num_ops = 0;
+                break;
+            }
+            op = _x65_decode(sys);
+            if ((W65816_GET_ADDR(sys->pins) >> 8) != page) {
+                break;
+            }
         }
-        else if (addr >= X65_IO_CGIA_BASE) {
-            cgia_reg_write((uint8_t)addr, data);
-            return;
+    }
+    return ticks;
+}
+
+uint8_t mem_rd(x65_t* sys, uint8_t bank, uint16_t addr) {
+    if ((bank == 0) && (sys->bus.page[addr >> 8] == X65_BUS_IO)) {
+        switch (sys->bus.io[addr & (X65_IO_LEN - 1)]) {
+            case X65_DEV_RIA: {
+                const uint8_t reg = addr & RIA816_RS;
+                switch (reg) {
+                    case RIA816_FS_FDARW:
+                    case RIA816_FS_FDBRW:
+                    case RIA816_UART_TX_RX:
+                    case RIA816_API_STACK: return 0xFF;
+                }
+                return ria816_reg_read(&sys->ria, reg);
+            }
+            case X65_DEV_HID: return ria816_hid_read(&sys->ria, addr & RIA816_HID_RS);
+            case X65_DEV_UNUSED: return 0xFF;
+            case X65_DEV_BUZZER: return 0xFF;
+            case X65_DEV_RGB: return ria816_rgb_read(&sys->ria, addr & RIA816_HID_RS);
+            case X65_DEV_TIMERS: {
+                const uint8_t reg = addr & RIA816_TIMERS_RS;
+                switch (reg) {
+                    case M6526_REG_ICR: return sys->ria.cia.intr.icr;
+                }
+                return m6526_read(&sys->ria.cia, reg);
+            }
+            case X65_DEV_GPIO: {
+                const uint8_t reg = addr & TCA6416A_RS;
+                switch (reg) {
+                    case TCA6416A_REG_IN0: return sys->gpio.p0.in;
+                    case TCA6416A_REG_IN1: return sys->gpio.p1.in;
+                }
+                return tca6416a_read(&sys->gpio, reg);
+            }
+            case X65_DEV_CGIA: return cgia_reg_read((uint8_t)addr);
+            case X65_DEV_SGU: return sgu1_reg_read(&sys->sgu, addr & SGU1_ADDR_MASK);
+            default: break;
         }
-        else if (addr >= X65_IO_SGU_BASE) {
-            sgu1_reg_write(&sys->sgu, addr & SGU1_ADDR_MASK, data);
-            return;
+    }
+    // else
+    return sys->ram[(bank << 16) | addr];
+}
+void mem_wr(x65_t* sys, uint8_t bank, uint16_t addr, uint8_t data) {
+    if ((bank == 0) && (sys->bus.page[addr >> 8] == X65_BUS_IO)) {
+        switch (sys->bus.io[addr & (X65_IO_LEN - 1)]) {
+            case X65_DEV_RIA:
+                ria816_reg_write(&sys->ria, addr & RIA816_RS, data);
+                if (sys->ria.reg[RIA816_EXT_IO] != sys->bus.ext_io) {
+                    _x65_bus_update(sys);
+                }
+                return;
+            case X65_DEV_HID: ria816_hid_write(&sys->ria, addr & RIA816_HID_RS, data); return;
+            case X65_DEV_UNUSED:
+            case X65_DEV_BUZZER: return;
+            case X65_DEV_RGB: ria816_rgb_write(&sys->ria, addr & RIA816_RGB_RS, data); return;
+            case X65_DEV_TIMERS:
+            case X65_DEV_GPIO: return;
+            case X65_DEV_CGIA: cgia_reg_write((uint8_t)addr, data); return;
+            case X65_DEV_SGU: sgu1_reg_write(&sys->sgu, addr & SGU1_ADDR_MASK, data); return;
+            default: break;
         }
     }
     // else
     mem_ram_write(sys, (bank << 16) | addr, data);
 }
+// save a RAM page to the run-ahead journal before its first write
+static void _x65_runahead_save_page(x65_t* sys, uint32_t page) {
+    x65_runahead_t* ra = sys->runahead;
+    if (ra->page_saved[page >> 5] & (1U << (page & 31))) {
+        return;
+    }
+    ra->page_saved[page >> 5] |= 1U << (page & 31);
+    if (ra->num_pages == ra->max_pages) {
+        ra->max_pages *= 2;
+        ra->page = realloc(ra->page, ra->max_pages * sizeof(uint32_t));
+        ra->page_data = realloc(ra->page_data, (size_t)ra->max_pages << 8);
+        CHIPS_ASSERT(ra->page && ra->page_data);
+    }
+    ra->page[ra->num_pages] = page;
+    memcpy(&ra->page_data[(size_t)ra->num_pages << 8], &sys->ram[page << 8], 256);
+    ra->num_pages++;
+}
 
 void mem_ram_write(x65_t* sys, uint32_t addr, uint8_t data) {
+    if (sys->runahead) {
+        _x65_runahead_save_page(sys, addr >> 8);
+    }
     sys->ram[addr] = data;
-    cgia_ram_write((uint8_t)(addr >> 16), (uint16_t)addr, data);
+    sys->spin.state = _X65_SPIN_IDLE;
+    if (sys->blocks) {
+        _x65_blocks_invalidate(sys->blocks, addr >> 8);
+    }
+    cgia_mem_write(&sys->cgia, (uint8_t)(addr >> 16), (uint16_t)addr, data);
 }
 
 uint8_t mem_ram_read(x65_t* sys, uint32_t addr) {
     return sys->ram[addr];
 }
 
+void x65_read_ram(x65_t* sys, uint32_t addr, uint8_t* dst, size_t num_bytes) {
+    CHIPS_ASSERT(sys && sys->valid && dst);
+    while (num_bytes > 0) {
+        addr &= X65_RAM_SIZE_BYTES - 1;
+        size_t n = X65_RAM_SIZE_BYTES - addr;
+        if (n > num_bytes) n = num_bytes;
+        memcpy(dst, &sys->ram[addr], n);
+        dst += n;
+        addr += n;
+        num_bytes -= n;
+    }
+}
+
+void x65_write_ram(x65_t* sys, uint32_t addr, const uint8_t* src, size_t num_bytes) {
+    CHIPS_ASSERT(sys && sys->valid && src);
+    for (size_t i = 0; i < num_bytes; i++) {
+        mem_ram_write(sys, (addr + i) & (X65_RAM_SIZE_BYTES - 1), src[i]);
+    }
+}
+
 uint8_t _x65_vpu_fetch(uint32_t addr, void* user_data) {
     x65_t* sys = (x65_t*)user_data;
     return sys->ram[addr & 0xFFFFFF];
 }
 
-uint32_t x65_exec(x65_t* sys, uint32_t micro_seconds) {
-    CHIPS_ASSERT(sys && sys->valid);
-    uint32_t num_ticks = clk_us_to_ticks(X65_FREQUENCY, micro_seconds);
-    uint64_t pins = sys->pins;
+static void _x65_exec_ticks(x65_t* sys, uint32_t num_ticks) {
+    // the joystick inputs of the GPIO extender may have changed
+    sys->sched.deadline[X65_SCHED_GPIO] = sys->sched.next = sys->sched.now;
     if (0 == sys->debug.callback.func) {
-        // run without debug callback
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-            pins = _x65_tick(sys, pins);
+        // run without debug callback, one instruction at a time, ticks
+        // done ahead by a cut short spin loop fast-forward are caught up
+        uint32_t ticks = sys->step.overrun;
+        const bool blocks = (sys->cpu_engine == X65_CPU_ENGINE_BLOCKS);
+        while ((ticks < num_ticks) || (sys->spin.pos < sys->spin.ahead)) {
+            const uint32_t budget = (ticks < num_ticks) ? (num_ticks - ticks) : 1;
+            uint32_t done = 0;
+            if (sys->spin.state == _X65_SPIN_SPINNING) {
+                done = _x65_spin_fast_forward(sys, budget);
+            }
+            else if (!sys->running || sys->cpu.stopped) {
+                done = _x65_idle(sys, budget);
+            }
+            if (0 == done) {
+                done = blocks ? _x65_step_block(sys, budget) : _x65_step(sys);
+            }
+            ticks += done;
         }
+        sys->step.overrun = ticks - num_ticks;
     }
     else {
         // run with debug callback
+        uint64_t pins = sys->pins;
         for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
             pins = _x65_tick(sys, pins);
             sys->debug.callback.func(sys->debug.callback.user_data, pins);
         }
+        sys->pins = pins;
     }
-    sys->pins = pins;
+    _x65_sched_sync(sys);
+}
+
+static void _x65_apply_input(x65_t* sys, const x65_input_event_t* ev) {
+    switch (ev->type) {
+        case X65_INPUT_KEY_DOWN: x65_key_down(sys, ev->arg); break;
+        case X65_INPUT_KEY_UP: x65_key_up(sys, ev->arg); break;
+        case X65_INPUT_KEY_TAP: {
+            const x65_joystick_type_t joy_type = sys->joystick_type;
+            sys->joystick_type = X65_JOYSTICKTYPE_NONE;
+            x65_key_down(sys, ev->arg);
+            x65_key_up(sys, ev->arg);
+            sys->joystick_type = joy_type;
+        } break;
+        default: break;
+    }
+}
+
+bool x65_input(x65_t* sys, x65_input_type_t type, int arg, uint32_t micro_seconds) {
+    CHIPS_ASSERT(sys && sys->valid);
+    if (sys->input.num == X65_MAX_INPUT_EVENTS) {
+        // losing a key up would leave the key stuck, apply the queue in order now
+        LOG_WARNING("Input queue full, applying %u events without timing", sys->input.num + 1);
+        for (uint32_t i = 0; i < sys->input.num; i++) {
+            _x65_apply_input(sys, &sys->input.event[i]);
+        }
+        sys->input.num = 0;
+        _x65_apply_input(sys, &(x65_input_event_t){ .type = type, .arg = arg });
+        return false;
+    }
+    const uint32_t tick = clk_us_to_ticks(X65_FREQUENCY, micro_seconds);
+    // insert behind all events at the same tick, to keep their order
+    uint32_t i = sys->input.num++;
+    for (; (i > 0) && (sys->input.event[i - 1].tick > tick); i--) {
+        sys->input.event[i] = sys->input.event[i - 1];
+    }
+    sys->input.event[i] = (x65_input_event_t){ .tick = tick, .type = type, .arg = arg };
+    return true;
+}
+
+uint32_t x65_exec(x65_t* sys, uint32_t micro_seconds) {
+    CHIPS_ASSERT(sys && sys->valid);
+    const uint32_t num_ticks = clk_us_to_ticks(X65_FREQUENCY, micro_seconds);
+    // split the exec at queued input events, late events are applied at the end
+    uint32_t ticks = 0;
+    for (uint32_t i = 0; i < sys->input.num; i++) {
+        const x65_input_event_t* ev = &sys->input.event[i];
+        const uint32_t at = (ev->tick < num_ticks) ? ev->tick : num_ticks;
+        if (at > ticks) {
+            _x65_exec_ticks(sys, at - ticks);
+            ticks = at;
+        }
+        _x65_apply_input(sys, ev);
+    }
+    sys->input.num = 0;
+    if (ticks < num_ticks) {
+        _x65_exec_ticks(sys, num_ticks - ticks);
+    }
+    return num_ticks;
+}
+
+uint32_t x65_exec_warp(x65_t* sys, uint32_t budget_us) {
+    CHIPS_ASSERT(sys && sys->valid);
+    const uint32_t frame_us = 1000000 / MODE_V_FREQ_HZ;
+    const uint64_t start = _x65_prof_now();
+    uint32_t ticks = 0;
+    x65_set_warp(sys, true);
+    while ((_x65_prof_now() - start) < ((uint64_t)budget_us * 1000)) {
+        ticks += x65_exec(sys, frame_us);
+    }
+    x65_set_warp(sys, false);
+    ticks += x65_exec(sys, frame_us);
+    return ticks;
+}
+
+// the saved machine state is everything up to the RAM, the block cache stays
+// valid as long as restored code pages are invalidated
+#define _X65_RUNAHEAD_STATE_SIZE (offsetof(x65_t, ram))
+
+void x65_runahead_init(x65_runahead_t* ra) {
+    CHIPS_ASSERT(ra);
+    memset(ra, 0, sizeof(*ra));
+    ra->state = malloc(_X65_RUNAHEAD_STATE_SIZE);
+    ra->fw_state = malloc(cgia_fw_state_size());
+    ra->max_pages = 256;
+    ra->page = malloc(ra->max_pages * sizeof(uint32_t));
+    ra->page_data = malloc((size_t)ra->max_pages << 8);
+    CHIPS_ASSERT(ra->state && ra->fw_state && ra->page && ra->page_data);
+}
+
+void x65_runahead_discard(x65_runahead_t* ra) {
+    CHIPS_ASSERT(ra);
+    free(ra->state);
+    free(ra->fw_state);
+    free(ra->page);
+    free(ra->page_data);
+    memset(ra, 0, sizeof(*ra));
+}
+
+static void _x65_runahead_save(x65_t* sys, x65_runahead_t* ra) {
+    memcpy(ra->state, sys, _X65_RUNAHEAD_STATE_SIZE);
+    cgia_fw_state_save(ra->fw_state);
+    for (uint32_t line = 0; line < CGIA_ACTIVE_HEIGHT; line++) {
+        ra->line_sig[line] = sys->fb_line_sig[line].sig;
+    }
+    ra->num_pages = 0;
+    sys->runahead = ra;
+}
+
+static void _x65_runahead_restore(x65_t* sys, x65_runahead_t* ra) {
+    memcpy(sys, ra->state, _X65_RUNAHEAD_STATE_SIZE);
+    cgia_fw_state_load(ra->fw_state);
+    // the framebuffer isn't rolled back, lines rasterized while running ahead
+    // were signed with VRAM cache generations the machine is going to reuse
+    for (uint32_t line = 0; line < CGIA_ACTIVE_HEIGHT; line++) {
+        if (sys->fb_line_sig[line].sig != ra->line_sig[line]) {
+            sys->fb_line_sig[line].sig = 0;
+        }
+    }
+    for (uint32_t i = 0; i < ra->num_pages; i++) {
+        const uint32_t page = ra->page[i];
+        memcpy(&sys->ram[page << 8], &ra->page_data[(size_t)i << 8], 256);
+        ra->page_saved[page >> 5] &= ~(1U << (page & 31));
+        if (sys->blocks) {
+            _x65_blocks_invalidate(sys->blocks, page);
+        }
+    }
+    ra->num_pages = 0;
+}
+
+uint32_t x65_exec_runahead(x65_t* sys, x65_runahead_t* ra, uint32_t micro_seconds, uint32_t num_frames) {
+    CHIPS_ASSERT(sys && sys->valid && ra && ra->state);
+    const bool stopped = sys->debug.callback.func && *sys->debug.stopped;
+    if ((num_frames == 0) || stopped) {
+        return x65_exec(sys, micro_seconds);
+    }
+    // the real timeline, its frame is never shown
+    const bool fb_skip = sys->cgia.fb_skip;
+    sys->cgia.fb_skip = true;
+    const uint32_t num_ticks = x65_exec(sys, micro_seconds);
+    sys->cgia.fb_skip = fb_skip;
+
+    // run ahead without audio output and debugger, only the last frame is shown
+    _x65_runahead_save(sys, ra);
+    sys->debug.callback.func = 0;
+    sys->warp = true;
+    for (uint32_t i = 0; i < num_frames; i++) {
+        sys->cgia.fb_skip = (i + 1) < num_frames;
+        x65_exec(sys, 1000000 / MODE_V_FREQ_HZ);
+    }
+    _x65_runahead_restore(sys, ra);
     return num_ticks;
 }
 
@@ -403,23 +1172,23 @@ void x65_key_down(x65_t* sys, int key_code) {
     bool handled = false;
     uint8_t m = 0;
     switch (key_code) {
-        case 0x20:                                  // SPACE
-        case 0x4A:                                  // J
-        case 0x5A: m = X65_JOYSTICK_BTN; break;     // Z
-        case 0x4B:                                  // K
-        case 0x58: m = X65_JOYSTICK_BTN2; break;    // X
-        case 0x4C:                                  // L
-        case 0x43: m = X65_JOYSTICK_BTN3; break;    // C
-        case 0x3B:                                  // ;
-        case 0x56: m = X65_JOYSTICK_BTN4; break;    // V
-        case 0x41:                                  // A
-        case 0x107: m = X65_JOYSTICK_LEFT; break;   // CURSOR_LEFT
-        case 0x44:                                  // D
-        case 0x106: m = X65_JOYSTICK_RIGHT; break;  // CURSOR_RIGHT
-        case 0x53:                                  // S
-        case 0x108: m = X65_JOYSTICK_DOWN; break;   // CURSOR_DOWN
-        case 0x57:                                  // W
-        case 0x109: m = X65_JOYSTICK_UP; break;     // CURSOR_UP
+        case 0x2C:                                 // SPACE
+        case 0x0D:                                 // J
+        case 0x1D: m = X65_JOYSTICK_BTN; break;    // Z
+        case 0x0E:                                 // K
+        case 0x1B: m = X65_JOYSTICK_BTN2; break;   // X
+        case 0x0F:                                 // L
+        case 0x06: m = X65_JOYSTICK_BTN3; break;   // C
+        case 0x33:                                 // ;
+        case 0x19: m = X65_JOYSTICK_BTN4; break;   // V
+        case 0x04:                                 // A
+        case 0x50: m = X65_JOYSTICK_LEFT; break;   // ARROW_LEFT
+        case 0x07:                                 // D
+        case 0x4F: m = X65_JOYSTICK_RIGHT; break;  // ARROW_RIGHT
+        case 0x16:                                 // S
+        case 0x51: m = X65_JOYSTICK_DOWN; break;   // ARROW_DOWN
+        case 0x1A:                                 // W
+        case 0x52: m = X65_JOYSTICK_UP; break;     // ARROW_UP
         default: break;
     }
     if (m != 0) {
@@ -437,7 +1206,7 @@ void x65_key_down(x65_t* sys, int key_code) {
     }
     if (!handled) {
         // joy did not grab this key - pass to HID keyboard
-        hid_key_down(key_code);
+        hid_key_down(sys->kbd_keys, key_code);
     }
 }
 
@@ -446,23 +1215,23 @@ void x65_key_up(x65_t* sys, int key_code) {
     bool handled = false;
     uint8_t m = 0;
     switch (key_code) {
-        case 0x20:
-        case 0x4A:
-        case 0x5A: m = X65_JOYSTICK_BTN; break;
-        case 0x4B:
-        case 0x58: m = X65_JOYSTICK_BTN2; break;
-        case 0x4C:
-        case 0x43: m = X65_JOYSTICK_BTN3; break;
-        case 0x3B:
-        case 0x56: m = X65_JOYSTICK_BTN4; break;
-        case 0x41:
-        case 0x107: m = X65_JOYSTICK_LEFT; break;
-        case 0x44:
-        case 0x106: m = X65_JOYSTICK_RIGHT; break;
-        case 0x53:
-        case 0x108: m = X65_JOYSTICK_DOWN; break;
-        case 0x57:
-        case 0x109: m = X65_JOYSTICK_UP; break;
+        case 0x2C:                                 // SPACE
+        case 0x0D:                                 // J
+        case 0x1D: m = X65_JOYSTICK_BTN; break;    // Z
+        case 0x0E:                                 // K
+        case 0x1B: m = X65_JOYSTICK_BTN2; break;   // X
+        case 0x0F:                                 // L
+        case 0x06: m = X65_JOYSTICK_BTN3; break;   // C
+        case 0x33:                                 // ;
+        case 0x19: m = X65_JOYSTICK_BTN4; break;   // V
+        case 0x04:                                 // A
+        case 0x50: m = X65_JOYSTICK_LEFT; break;   // ARROW_LEFT
+        case 0x07:                                 // D
+        case 0x4F: m = X65_JOYSTICK_RIGHT; break;  // ARROW_RIGHT
+        case 0x16:                                 // S
+        case 0x51: m = X65_JOYSTICK_DOWN; break;   // ARROW_DOWN
+        case 0x1A:                                 // W
+        case 0x52: m = X65_JOYSTICK_UP; break;     // ARROW_UP
         default: break;
     }
     if (m != 0) {
@@ -480,7 +1249,7 @@ void x65_key_up(x65_t* sys, int key_code) {
     }
     if (!handled) {
         // joy did not grab this key - pass to HID keyboard
-        hid_key_up(key_code);
+        hid_key_up(sys->kbd_keys, key_code);
     }
 }
 
@@ -592,29 +1361,48 @@ chips_display_info_t x65_display_info(x65_t* sys) {
                 .width = CGIA_FRAMEBUFFER_WIDTH,
                 .height = CGIA_FRAMEBUFFER_HEIGHT,
             },
-            .bytes_per_pixel = 4,
+            .bytes_per_pixel = CGIA_FB_BYTES_PER_PIXEL,
             .buffer = {
                 .ptr = sys ? sys->fb : 0,
                 .size = CGIA_FRAMEBUFFER_SIZE_BYTES,
             }
         },
+        .dirty = {
+            .valid = sys != 0,
+            .top = sys ? sys->fb_dirty.top : 0,
+            .bottom = sys ? sys->fb_dirty.bottom : 0,
+        },
+#ifdef CGIA_INDEXED_FB
+        .palette = {
+            .ptr = sys ? sys->cgia.hwcolors : 0,
+            .size = CGIA_HWCOLOR_NUM * sizeof(uint32_t),
+        },
+#endif
         .screen = {
             .x = 0,
             .y = 0,
-            .width = CGIA_DISPLAY_WIDTH,
-            .height = CGIA_DISPLAY_HEIGHT,
+            .width = CGIA_FRAMEBUFFER_WIDTH,
+            .height = CGIA_FRAMEBUFFER_HEIGHT,
         },
     };
     CHIPS_ASSERT(((sys == 0) && (res.frame.buffer.ptr == 0)) || ((sys != 0) && (res.frame.buffer.ptr != 0)));
     return res;
 }
 
+void x65_display_presented(x65_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->fb_dirty = CGIA_DIRTY_NONE;
+}
+
 uint32_t x65_save_snapshot(x65_t* sys, x65_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+    dst->runahead = 0;
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     w65816_snapshot_onsave(&dst->cpu);
+    dst->blocks = 0;
+    memset(&dst->spin, 0, sizeof(dst->spin));
     cgia_snapshot_onsave(&dst->cgia);
     return X65_SNAPSHOT_VERSION;
 }
@@ -629,8 +1417,21 @@ bool x65_load_snapshot(x65_t* sys, uint32_t version, x65_t* src) {
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     w65816_snapshot_onload(&im.cpu, &sys->cpu);
+    im.cpu_engine = sys->cpu_engine;
+    im.blocks = sys->blocks;
+    _x65_blocks_flush(im.blocks);
+    memset(&im.spin, 0, sizeof(im.spin));
     cgia_snapshot_onload(&im.cgia, &sys->cgia);
+    im.warp = sys->warp;
+    im.frame_skip = sys->frame_skip;
+    im.prof = sys->prof;
+    // the snapshot brings its own framebuffer contents
+    im.fb_dirty = CGIA_DIRTY_ALL;
+    // the VRAM cache isn't part of the snapshot, don't trust the line signatures
+    memset(im.fb_line_sig, 0, sizeof(im.fb_line_sig));
     *sys = im;
+    // bring the firmware keyboard driver in line with the restored keys
+    hid_key_up(sys->kbd_keys, 0);
     return true;
 }
 
@@ -639,6 +1440,9 @@ bool x65_load_snapshot(x65_t* sys, uint32_t version, x65_t* src) {
 #include "term/font.h"
 static const uint8_t* font_8hi(uint16_t cp);
 
+// the firmware API helpers work on these globals, the machine keeps the
+// registers in ria816_t (so they are part of snapshots) and swaps them in
+// for the duration of an API call
 volatile uint8_t regs[0x40];
 uint8_t xstack[XSTACK_SIZE + 1];
 size_t volatile xstack_ptr;
@@ -648,6 +1452,8 @@ void _x65_api_call(uint8_t data, void* user_data) {
 
     // sync RIA regs
     memcpy(regs, sys->ria.reg, sizeof(regs));
+    memcpy(xstack, sys->ria.xstack, sizeof(xstack));
+    xstack_ptr = sys->ria.xstack_ptr;
 
     switch (data) {
         case API_OP_ZXSTACK: {
@@ -684,6 +1490,8 @@ void _x65_api_call(uint8_t data, void* user_data) {
 
     // sync RIA regs back
     memcpy(sys->ria.reg, regs, sizeof(regs));
+    memcpy(sys->ria.xstack, xstack, sizeof(xstack));
+    sys->ria.xstack_ptr = xstack_ptr;
 }
 
 #define RP6502_CODE_PAGE 0
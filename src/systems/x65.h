@@ -11,6 +11,28 @@
     ~~~
         your own assert macro (default: assert(c))
 
+    ## Embedding
+
+    The `x65` CMake target builds the machine, its chips and the firmware
+    glue as a library without any window, audio device or UI dependencies.
+    Log messages of the machine, the chips and the firmware go to the log
+    callback in x65_desc_t, or to stderr until a machine with a log
+    callback is initialized.
+
+    Frames are retrieved with x65_display_info(), audio through the
+    callback in x65_desc_t, and input is injected with x65_key_down(),
+    x65_key_up() and x65_joystick(). Key codes are USB HID keyboard
+    usage IDs (e.g. 0x04 for A, 0x28 for ENTER).
+
+    Only one x65_t can be live in a process at a time. The firmware
+    sources the machine is built from keep the CGIA plane and register
+    state, the VRAM cache, the keyboard, mouse and gamepad drivers and
+    the API call registers in globals, so the machine isn't re-entrant
+    and is only ever run from one thread at a time. x65_init() logs an
+    error and asserts when a second machine is initialized before the
+    first one is discarded. Run parallel machines in separate processes,
+    like emu-fleet does.
+
     ## The X65
 
     TODO!
@@ -45,7 +67,7 @@ extern "C" {
 #endif
 
 // bump snapshot version when x65_t memory layout changes
-#define X65_SNAPSHOT_VERSION (1)
+#define X65_SNAPSHOT_VERSION (18)
 
 #define X65_FREQUENCY             (3140000)  // clock frequency in Hz
 #define X65_MAX_AUDIO_SAMPLES     (2048)     // max number of audio samples in internal sample buffer
@@ -128,11 +150,119 @@ typedef enum {
 #define X65_INT_IO2  (1 << 6)  // IO2 interrupt
 #define X65_INT_IO3  (1 << 7)  // IO3 interrupt
 
+// bank 0 address decoding, one entry per 256 byte page
+typedef enum {
+    X65_BUS_RAM,  // plain RAM
+    X65_BUS_EXT,  // extension bus slots mapped by RIA816_EXT_IO
+    X65_BUS_IO,   // on-board chips, see x65_bus_dev_t
+} x65_bus_page_t;
+
+// devices in the on-board IO area (FE00..FFFF)
+typedef enum {
+    X65_DEV_NONE,    // FE00..FEAF
+    X65_DEV_MIXER,   // FEB0..FEBF
+    X65_DEV_SGU,     // FEC0..FEFF
+    X65_DEV_CGIA,    // FF00..FF7F
+    X65_DEV_GPIO,    // FF80..FF97
+    X65_DEV_TIMERS,  // FF98..FF9F
+    X65_DEV_RGB,     // FFA0..FFA7
+    X65_DEV_BUZZER,  // FFA8..FFAB
+    X65_DEV_UNUSED,  // FFAC..FFAF
+    X65_DEV_HID,     // FFB0..FFBF
+    X65_DEV_RIA,     // FFC0..FFFF
+} x65_bus_dev_t;
+#define X65_IO_LEN (0x200)
+
+// CPU execution engines
+typedef enum {
+    X65_CPU_ENGINE_STEP,    // run one decoded instruction at a time (default)
+    X65_CPU_ENGINE_BLOCKS,  // replay basic blocks from the block cache
+} x65_cpu_engine_t;
+
+// basic block cache
+#define X65_BLOCK_CACHE_SIZE (4096)                     // number of cached blocks (power of 2)
+#define X65_BLOCK_MAX_OPS    (32)                       // max number of instructions per block
+#define X65_CODE_PAGES       (X65_RAM_SIZE_BYTES >> 8)  // number of 256 byte code pages
+
+// a basic block of predecoded instructions
+typedef struct {
+    uint32_t addr;                      // 24-bit address of the first instruction
+    uint16_t gen;                       // code page generation when the block was recorded
+    uint8_t table;                      // M/X/E decoder table the handlers were decoded with
+    uint8_t num_ops;                    // number of instructions, 0 if unused
+    w65816_op_t op[X65_BLOCK_MAX_OPS];  // instruction handlers (opcode and M/X/E decoder table)
+} x65_block_t;
+
+// basic block cache, a block is invalidated by RAM writes to its code page
+typedef struct {
+    uint32_t code_pages[X65_CODE_PAGES / 32];  // bitmap of pages with cached blocks
+    uint16_t page_gen[X65_CODE_PAGES];         // bumped when a code page is written
+    x65_block_t block[X65_BLOCK_CACHE_SIZE];
+} x65_blocks_t;
+
+// spin loop detection
+#define X65_SPIN_MAX_TICKS (64)  // max number of ticks per iteration of a spin loop
+#define X65_SPIN_MAX_BYTES (64)  // max distance of the backward jump closing a spin loop
+
+// chips driven by the peripheral scheduler
+typedef enum {
+    X65_SCHED_GPIO,
+    X65_SCHED_RIA,
+    X65_SCHED_CGIA,
+    X65_SCHED_SGU,
+    X65_SCHED_NUM,
+} x65_sched_chip_t;
+
+// most frames skipped between rasterized frames, see x65_adapt_frame_skip()
+#define X65_MAX_FRAME_SKIP (3)
+
+// input events applied inside x65_exec(), see x65_input()
+#define X65_MAX_INPUT_EVENTS (64)
+
+typedef enum {
+    X65_INPUT_KEY_DOWN,
+    X65_INPUT_KEY_UP,
+    X65_INPUT_KEY_TAP,  // key down and up, bypassing keyboard joystick emulation
+} x65_input_type_t;
+
+typedef struct {
+    uint32_t tick;  // tick offset into the next x65_exec()
+    uint32_t type;  // x65_input_type_t
+    int32_t arg;    // USB HID key code
+} x65_input_event_t;
+
+// run-ahead rollback journal, see x65_exec_runahead()
+typedef struct {
+    uint8_t* state;     // machine state without RAM and framebuffer
+    uint8_t* fw_state;  // CGIA firmware renderer state and VRAM cache journal
+    uint32_t page_saved[X65_CODE_PAGES / 32];  // bitmap of RAM pages saved since the rollback point
+    uint32_t num_pages;                        // number of saved RAM pages
+    uint32_t max_pages;                        // capacity of the saved RAM page buffers
+    uint32_t* page;                            // page numbers of the saved RAM pages
+    uint8_t* page_data;                        // contents of the saved RAM pages, 256 bytes each
+    uint64_t line_sig[CGIA_ACTIVE_HEIGHT];     // framebuffer line signatures at the rollback point
+} x65_runahead_t;
+
+// log callback, log_level is 0 (panic), 1 (error), 2 (warning) or 3 (info)
+typedef struct {
+    void (*func)(
+        uint32_t log_level,
+        const char* log_id,
+        const char* filename,
+        uint32_t line_nr,
+        const char* message,
+        void* user_data);
+    void* user_data;
+} x65_log_t;
+
 // config parameters for x65_init()
 typedef struct {
     x65_joystick_type_t joystick_type;  // default is X65_JOYSTICK_NONE
+    x65_cpu_engine_t cpu_engine;        // default is X65_CPU_ENGINE_STEP
+    bool zeromem;                       // don't fill RAM with random data
     chips_debug_t debug;                // optional debugging hook
     chips_audio_desc_t audio;           // audio output options
+    x65_log_t log;                      // log callback, default is stderr
 } x65_desc_t;
 
 // X65 emulator state
@@ -146,15 +276,84 @@ typedef struct {
     uint64_t pins;
 
     bool running;  // whether CPU is running or held in RESET state
+    bool warp;     // skip framebuffer and audio output to run faster than real time
+
+    // adaptive frame-skip, CGIA stops generating pixels for some frames
+    // while the host can't keep up
+    struct {
+        bool enabled;
+        float load;  // smoothed host time of x65_exec() per emulated time
+    } frame_skip;
+
+    // host time spent ticking the video and audio chips, only measured while enabled
+    struct {
+        bool enabled;
+        uint64_t cgia_ns;
+        uint64_t sgu_ns;
+    } prof;
+
+    // address decoder, the page table is rebuilt when RIA816_EXT_IO changes,
+    // banks other than 0 are plain RAM
+    struct {
+        uint8_t ext_io;           // RIA816_EXT_IO the page table was built for
+        uint8_t page[256];        // x65_bus_page_t of each bank 0 page
+        uint8_t io[X65_IO_LEN];   // x65_bus_dev_t of each IO area address
+    } bus;
+
+    // instruction-stepped execution state
+    struct {
+        uint32_t ticks;     // chip ticks already done in current instruction
+        uint64_t int_pins;  // IRQ/NMI pins after the last chip tick
+        uint32_t overrun;   // ticks executed past the end of last x65_exec()
+    } step;
+
+    // basic block cache, only allocated for X65_CPU_ENGINE_BLOCKS
+    x65_cpu_engine_t cpu_engine;
+    x65_blocks_t* blocks;
+
+    // spin loop detection, a loop which returns to the same CPU state without
+    // writing anything is fast-forwarded by replaying its bus reads to the chips
+    // around chip deadlines and skipping the iterations in between
+    struct {
+        uint8_t state;       // idle, recording or spinning
+        uint32_t head;       // 24-bit address of the loop head
+        uint64_t pins;       // CPU pins at the loop head
+        w65816_t cpu;        // CPU state at the loop head
+        uint32_t num_ticks;  // number of recorded ticks of one iteration
+        uint32_t ahead;      // ticks done ahead of the CPU by a cut short fast-forward
+        uint32_t pos;        // next tick replayed to the CPU
+        struct {
+            uint16_t addr;  // address of a trapped read
+            uint8_t data;   // data of a trapped read
+            uint8_t flags;  // tick type and interrupt pins
+        } tick[X65_SPIN_MAX_TICKS], replay[X65_SPIN_MAX_TICKS];
+    } spin;
+
+    // peripheral scheduler, a chip is only ticked at its deadline or when
+    // selected, the ticks in between are skipped when it is ticked next
+    struct {
+        uint64_t now;                       // number of ticks since x65_init()
+        uint64_t next;                      // earliest deadline of all chips
+        uint64_t synced[X65_SCHED_NUM];     // number of ticks done or skipped by each chip
+        uint64_t deadline[X65_SCHED_NUM];   // tick at which each chip must be ticked next
+    } sched;
+
+    // queued input events, sorted by tick offset
+    struct {
+        uint32_t num;
+        x65_input_event_t event[X65_MAX_INPUT_EVENTS];
+    } input;
 
     x65_joystick_type_t joystick_type;
     uint8_t kbd_joy1_mask;  // current joystick-1 state from keyboard-joystick emulation
     uint8_t kbd_joy2_mask;  // current joystick-2 state from keyboard-joystick emulation
     uint8_t joy_joy1_mask;  // current joystick-1 state from x65_joystick()
     uint8_t joy_joy2_mask;  // current joystick-2 state from x65_joystick()
+    uint32_t kbd_keys[8];   // USB HID key bitmap reported to the firmware keyboard driver
 
     bool valid;
     chips_debug_t debug;
+    x65_runahead_t* runahead;  // journal of RAM pages written while running ahead
 
     struct {
         chips_audio_callback_t callback;
@@ -165,6 +364,8 @@ typedef struct {
 
     alignas(64) uint8_t ram[X65_RAM_SIZE_BYTES];
     alignas(64) uint32_t fb[CGIA_FRAMEBUFFER_SIZE_BYTES / 4];
+    cgia_line_sig_t fb_line_sig[CGIA_ACTIVE_HEIGHT];  // CGIA input signature of each framebuffer line
+    cgia_dirty_t fb_dirty;                            // framebuffer rows changed since x65_display_presented()
 } x65_t;
 
 // initialize a new X65 instance
@@ -175,13 +376,38 @@ void x65_discard(x65_t* sys);
 void x65_reset(x65_t* sys);
 // start/stop X65 CPU
 void x65_set_running(x65_t* sys, bool running);
+// enable/disable warp mode, x65_exec() doesn't produce video and audio output while warping
+void x65_set_warp(x65_t* sys, bool warp);
+// enable/disable adaptive frame-skip, see x65_adapt_frame_skip()
+void x65_set_frame_skip(x65_t* sys, bool enable);
+// report the host time x65_exec() took to emulate micro_seconds, skip rasterizing
+// more frames while the host falls behind and fewer once it keeps up again
+void x65_adapt_frame_skip(x65_t* sys, uint32_t micro_seconds, uint32_t host_micro_seconds);
 // get framebuffer and display attributes
 chips_display_info_t x65_display_info(x65_t* sys);
+// mark the framebuffer as shown, x65_display_info() reports rows changed after this
+void x65_display_presented(x65_t* sys);
 // tick X65 instance for a given number of microseconds, return number of ticks executed
 uint32_t x65_exec(x65_t* sys, uint32_t micro_seconds);
-// send a key-down event to the X65
+// warp mode: run whole frames without video and audio output for budget_us of host
+// time, then one more frame with output to present, return number of ticks executed
+uint32_t x65_exec_warp(x65_t* sys, uint32_t budget_us);
+// tick X65 instance like x65_exec(), then emulate num_frames frames ahead into the
+// framebuffer without audio output and roll back, to cut input-to-display latency;
+// experimental: the rollback covers the machine, its RAM and the CGIA firmware state
+// listed in cgia.c, but not the private statics of the RIA, HID and CGIA firmware
+uint32_t x65_exec_runahead(x65_t* sys, x65_runahead_t* ra, uint32_t micro_seconds, uint32_t num_frames);
+// allocate the buffers of a run-ahead journal
+void x65_runahead_init(x65_runahead_t* ra);
+// free the buffers of a run-ahead journal
+void x65_runahead_discard(x65_runahead_t* ra);
+// queue an input event applied micro_seconds into the next x65_exec(), the
+// exec is split at the event, if the queue is full the queued events and this
+// one are applied immediately and false is returned
+bool x65_input(x65_t* sys, x65_input_type_t type, int arg, uint32_t micro_seconds);
+// send a key-down event to the X65, key_code is a USB HID keyboard usage ID
 void x65_key_down(x65_t* sys, int key_code);
-// send a key-up event to the X65
+// send a key-up event to the X65, key_code is a USB HID keyboard usage ID
 void x65_key_up(x65_t* sys, int key_code);
 // enable/disable joystick emulation
 void x65_set_joystick_type(x65_t* sys, x65_joystick_type_t type);
@@ -209,6 +435,10 @@ bool x65_is_tape_motor_on(x65_t* sys);
 uint32_t x65_save_snapshot(x65_t* sys, x65_t* dst);
 // load a snapshot, returns false if snapshot versions don't match
 bool x65_load_snapshot(x65_t* sys, uint32_t version, x65_t* src);
+// copy a range of RAM out, the 24-bit address wraps around, I/O is not touched
+void x65_read_ram(x65_t* sys, uint32_t addr, uint8_t* dst, size_t num_bytes);
+// copy a range into RAM like mem_ram_write(), the 24-bit address wraps around
+void x65_write_ram(x65_t* sys, uint32_t addr, const uint8_t* src, size_t num_bytes);
 
 // ---- memory access functions ----------------------------------------------
 /* write a byte to (PS)RAM, mirroring to CGIA L1 cache */
@@ -0,0 +1,164 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include "chips/cgia.h"
+
+#include <cstring>
+#include <functional>
+#include <random>
+
+using namespace std;
+
+// the firmware encoders, as declared by firmware/src/south/cgia/cgia_encode.h
+extern "C" {
+uint32_t* cgia_encode_mode_1(
+    uint32_t* rgbbuf,
+    uint32_t columns,
+    uint8_t shared_colors[8],
+    uint8_t bpp,
+    bool doubled,
+    bool mapped);
+uint32_t* cgia_encode_mode_3(
+    uint32_t* rgbbuf,
+    uint32_t columns,
+    uint8_t shared_colors[8],
+    bool multi,
+    bool doubled,
+    bool mapped);
+uint32_t* cgia_encode_mode_7(uint32_t* rgbbuf, uint32_t columns);
+}
+
+// most columns of a line, the encoders write up to 16 pixels per column
+#define MAX_COLUMNS (48)
+#define LINE_PIXELS (MAX_COLUMNS * 16)
+
+static cgia_t vpu;
+static uint32_t fb[CGIA_FRAMEBUFFER_SIZE_BYTES / 4];
+
+static uint8_t fetch(uint32_t addr, void* user_data) {
+    (void)addr;
+    (void)user_data;
+    return 0;
+}
+
+// a fresh CGIA with random VRAM cache contents, the encoders read the VRAM cache
+static void init_cgia(mt19937& rng) {
+    cgia_desc_t desc = {};
+    desc.tick_hz = 1000000;
+    desc.framebuffer.ptr = fb;
+    desc.framebuffer.size = sizeof(fb);
+    desc.fetch_cb = fetch;
+    cgia_init(&vpu, &desc);
+    for (int bank = 0; bank < 2; bank++) {
+        for (uint32_t addr = 0; addr < 0x10000; addr++) {
+            vpu.vram[bank][addr] = rng() & 0xFF;
+        }
+    }
+}
+
+static bool same_interp(const cgia_interp_t& a, const cgia_interp_t& b) {
+    return (a.accum[0] == b.accum[0]) && (a.accum[1] == b.accum[1]) && (a.base[0] == b.base[0])
+        && (a.base[1] == b.base[1]) && (a.base[2] == b.base[2]) && (a.shift[0] == b.shift[0])
+        && (a.shift[1] == b.shift[1]) && (a.mask[0] == b.mask[0]) && (a.mask[1] == b.mask[1]);
+}
+
+// run an encoder with the vectorized and with the scalar encoders from the same
+// interpolators and line contents, transparent pixels keep the line contents
+static void check_both_ways(mt19937& rng, const function<uint32_t*(uint32_t*)>& encode) {
+    const cgia_interp_t interp[2] = { vpu.interp[0], vpu.interp[1] };
+    static uint32_t line[2][LINE_PIXELS];
+    for (uint32_t i = 0; i < LINE_PIXELS; i++) {
+        line[0][i] = line[1][i] = rng();
+    }
+    uint32_t* end[2];
+    cgia_interp_t after[2][2];
+    for (int scalar = 0; scalar < 2; scalar++) {
+        cgia_set_simd(scalar == 0);
+        vpu.interp[0] = interp[0];
+        vpu.interp[1] = interp[1];
+        end[scalar] = encode(line[scalar]);
+        after[scalar][0] = vpu.interp[0];
+        after[scalar][1] = vpu.interp[1];
+    }
+    cgia_set_simd(true);
+    REQUIRE((end[0] - line[0]) == (end[1] - line[1]));
+    CHECK(memcmp(line[0], line[1], sizeof(line[0])) == 0);
+    CHECK(same_interp(after[0][0], after[1][0]));
+    CHECK(same_interp(after[0][1], after[1][1]));
+}
+
+static void random_colors(mt19937& rng, uint8_t colors[8]) {
+    for (int i = 0; i < 8; i++) colors[i] = rng() & 0xFF;
+}
+
+TEST_CASE("MODE1 encoders match the scalar encoders") {
+    if (!cgia_set_simd(true)) {
+        MESSAGE("built without vectorized encoders, comparing the scalar encoders with themselves");
+    }
+    mt19937 rng(0xC61A1);
+    init_cgia(rng);
+    for (int i = 0; i < 2000; i++) {
+        const uint32_t columns = 1 + rng() % MAX_COLUMNS;
+        const uint8_t bpp = (uint8_t)(1 + rng() % 4);
+        const bool doubled = rng() & 1;
+        const bool mapped = rng() & 1;
+        uint8_t colors[8];
+        random_colors(rng, colors);
+        // linear scan of the bitmap, row_height bytes apart
+        vpu.interp[0] = {};
+        vpu.interp[0].accum[0] = (uintptr_t)(vpu.vram[0] + rng() % 0x1000);
+        vpu.interp[0].base[0] = 1 + rng() % 16;
+        check_both_ways(rng, [&](uint32_t* rgbbuf) {
+            return cgia_encode_mode_1(rgbbuf, columns, colors, bpp, doubled, mapped);
+        });
+    }
+}
+
+TEST_CASE("MODE3 encoders match the scalar encoders") {
+    mt19937 rng(0xC61A3);
+    init_cgia(rng);
+    for (int i = 0; i < 2000; i++) {
+        const uint32_t columns = 1 + rng() % MAX_COLUMNS;
+        const bool multi = rng() & 1;
+        const bool doubled = rng() & 1;
+        const bool mapped = rng() & 1;
+        uint8_t colors[8];
+        random_colors(rng, colors);
+        // linear scans of the bitmap and of the foreground and background colors
+        vpu.interp[0] = {};
+        vpu.interp[0].accum[0] = (uintptr_t)(vpu.vram[0] + rng() % 0x1000);
+        vpu.interp[0].base[0] = 1 + rng() % 16;
+        vpu.interp[1] = {};
+        vpu.interp[1].accum[0] = (uintptr_t)(vpu.vram[1] + rng() % 0x1000);
+        vpu.interp[1].base[0] = 1;
+        vpu.interp[1].accum[1] = (uintptr_t)(vpu.vram[1] + rng() % 0x1000);
+        vpu.interp[1].base[1] = 1;
+        check_both_ways(rng, [&](uint32_t* rgbbuf) {
+            return cgia_encode_mode_3(rgbbuf, columns, colors, multi, doubled, mapped);
+        });
+    }
+}
+
+TEST_CASE("MODE7 encoders match the scalar encoders") {
+    mt19937 rng(0xC61A7);
+    init_cgia(rng);
+    for (int i = 0; i < 2000; i++) {
+        const uint32_t columns = 1 + rng() % MAX_COLUMNS;
+        // texture row and column scan with random texture size and affine steps,
+        // configured like set_mode7_interp_config() and set_mode7_scans() do
+        const uint8_t fractional_bits = 8;
+        const uint32_t width_bits = 1 + rng() % 8;
+        const uint32_t height_bits = 1 + rng() % 8;
+        vpu.interp[0] = {};
+        vpu.interp[0].shift[0] = fractional_bits;
+        vpu.interp[0].mask[0] = (1U << width_bits) - 1;
+        vpu.interp[0].shift[1] = (uint8_t)(fractional_bits - width_bits);
+        vpu.interp[0].mask[1] = ((1U << height_bits) - 1) << width_bits;
+        vpu.interp[0].accum[0] = rng();
+        vpu.interp[0].accum[1] = rng();
+        vpu.interp[0].base[0] = (uintptr_t)(intptr_t)(int16_t)rng();
+        vpu.interp[0].base[1] = (uintptr_t)(intptr_t)(int16_t)rng();
+        vpu.interp[0].base[2] = (uintptr_t)vpu.vram[0];
+        check_both_ways(rng, [&](uint32_t* rgbbuf) { return cgia_encode_mode_7(rgbbuf, columns); });
+    }
+}
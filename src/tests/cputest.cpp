@@ -10,6 +10,8 @@
 #include <string>
 #include <algorithm>
 #include <string>
+#include <random>
+#include <vector>
 
 using namespace std;
 
@@ -515,3 +517,228 @@ TEST_CASE("JSL jumps long") {
     CHECK(stack[1] == 0x00);  // PCH
     CHECK(stack[2] == 0x03);  // PCL
 }
+
+TEST_CASE("register setters switch decoder tables") {
+    w65816_t cpu;
+    w65816_desc_t desc = {};
+    uint64_t pins = w65816_init(&cpu, &desc);
+
+    // skip RESET
+    pins &= ~(W65816_RW | W65816_RES);
+    cpu.PINS = pins;
+
+    uint8_t memory[] = {
+        0xa9, 0x34, 0x12,  // lda #$1234
+        0xa9, 0x56,        // lda #$56
+    };
+    auto run = [&](int cycles) {
+        for (int cycle = 0; cycle < cycles; cycle++) {
+            uint16_t addr = W65816_GET_ADDR(pins) & 0xFFFF;
+            W65816_SET_DATA(pins, addr < sizeof(memory) ? memory[addr] : 0xEA);
+            pins = w65816_tick(&cpu, pins);
+        }
+    };
+
+    // native mode, 16-bit accumulator
+    w65816_set_e(&cpu, false);
+    w65816_set_p(&cpu, 0);
+    cpu.PC = 0x0000;
+    cpu.PBR = 0x00;
+    pins |= W65816_RW | W65816_VPA | W65816_VDA;
+    run(3);
+    CHECK(cpu.C == 0x1234);
+    CHECK((pins & W65816_VPA) && (pins & W65816_VDA));
+
+    // 8-bit accumulator, B is preserved
+    w65816_set_p(&cpu, W65816_MF);
+    run(2);
+    CHECK(cpu.C == 0x1256);
+    CHECK((pins & W65816_VPA) && (pins & W65816_VDA));
+}
+
+TEST_CASE("instruction stepping matches cycle stepping") {
+    // run random memory contents through both cores, random opcodes
+    // exercise all M/X/E modes and addressing modes
+    std::vector<uint8_t> tick_mem(1 << 24);
+    std::vector<uint8_t> step_mem(1 << 24);
+    std::mt19937 rng(0x65816);
+    for (auto& b : tick_mem) {
+        b = rng() & 0xFF;
+        if (b == 0xCB || b == 0xDB) b = 0xEA;  // replace WAI/STP with NOP
+    }
+    step_mem = tick_mem;
+
+    w65816_t tick_cpu, step_cpu;
+    w65816_desc_t tick_desc = {};
+    w65816_desc_t step_desc = {};
+    step_desc.step.mem = step_mem.data();
+    step_desc.step.trap_start = 0xFF00;
+    step_desc.step.trap_end = 0xFFFF;
+    step_desc.step.trap_cb = [](uint32_t addr, uint8_t data, bool write, uint32_t, void* user_data) -> uint8_t {
+        auto mem = (uint8_t*)user_data;
+        if (write) mem[addr] = data;
+        return mem[addr];
+    };
+    step_desc.step.user_data = step_mem.data();
+    uint64_t tick_pins = w65816_init(&tick_cpu, &tick_desc);
+    uint64_t step_pins = w65816_init(&step_cpu, &step_desc);
+
+    for (int i = 0; i < 100000; i++) {
+        const uint64_t irq = ((rng() & 7) == 0 ? W65816_IRQ : 0) | ((rng() & 15) == 0 ? W65816_NMI : 0);
+        tick_pins = (tick_pins & ~(W65816_IRQ | W65816_NMI)) | irq;
+        step_pins = (step_pins & ~(W65816_IRQ | W65816_NMI)) | irq;
+
+        uint32_t ticks = 0;
+        do {
+            tick_pins = w65816_tick(&tick_cpu, tick_pins);
+            const uint32_t addr = W65816_GET_ADDR(tick_pins);
+            if (tick_pins & W65816_RW) {
+                W65816_SET_DATA(tick_pins, tick_mem[addr]);
+            }
+            else {
+                tick_mem[addr] = W65816_GET_DATA(tick_pins);
+            }
+            ticks++;
+        } while (!((tick_pins & W65816_VPA) && (tick_pins & W65816_VDA)));
+        const uint32_t steps = w65816_step(&step_cpu, &step_pins);
+
+        CAPTURE(i);
+        REQUIRE(steps == ticks);
+        REQUIRE(step_pins == tick_pins);
+        REQUIRE(step_cpu.PC == tick_cpu.PC);
+        REQUIRE(step_cpu.PBR == tick_cpu.PBR);
+        REQUIRE(step_cpu.DBR == tick_cpu.DBR);
+        REQUIRE(step_cpu.C == tick_cpu.C);
+        REQUIRE(step_cpu.X == tick_cpu.X);
+        REQUIRE(step_cpu.Y == tick_cpu.Y);
+        REQUIRE(step_cpu.S == tick_cpu.S);
+        REQUIRE(step_cpu.D == tick_cpu.D);
+        REQUIRE(step_cpu.P == tick_cpu.P);
+        REQUIRE(step_cpu.emulation == tick_cpu.emulation);
+    }
+    CHECK(step_mem == tick_mem);
+}
+
+TEST_CASE("interrupt callback matches cycle stepping") {
+    // interrupt pins changing in any tick of an instruction are picked up
+    // through the interrupt callback in the same cycle as by w65816_tick()
+    std::vector<uint8_t> tick_mem(1 << 24);
+    std::vector<uint8_t> step_mem(1 << 24);
+    std::mt19937 rng(0x6502);
+    for (auto& b : tick_mem) {
+        b = rng() & 0xFF;
+        if (b == 0xCB || b == 0xDB) b = 0xEA;  // replace WAI/STP with NOP
+    }
+    step_mem = tick_mem;
+
+    // interrupt pins of each tick, changing every few ticks
+    static std::vector<uint64_t> int_pins(1 << 21);
+    uint64_t irq = 0;
+    for (auto& p : int_pins) {
+        if ((rng() & 7) == 0) irq ^= W65816_IRQ;
+        if ((rng() & 15) == 0) irq ^= W65816_NMI;
+        p = irq;
+    }
+
+    static w65816_t tick_cpu, step_cpu;
+    static uint32_t step_start;
+    w65816_desc_t tick_desc = {};
+    w65816_desc_t step_desc = {};
+    step_desc.step.mem = step_mem.data();
+    step_desc.step.int_cb = [](uint32_t cycle, void*) -> uint64_t {
+        step_cpu.step.int_cycle = cycle + 1;
+        return int_pins[step_start + cycle];
+    };
+    uint64_t tick_pins = w65816_init(&tick_cpu, &tick_desc);
+    uint64_t step_pins = w65816_init(&step_cpu, &step_desc);
+
+    uint32_t tick = 0;
+    for (int i = 0; (i < 100000) && (tick < int_pins.size() - 64); i++) {
+        step_start = tick;
+        step_cpu.step.int_cycle = 1;
+        step_pins = (step_pins & ~(W65816_IRQ | W65816_NMI)) | int_pins[tick];
+        uint32_t ticks = 0;
+        do {
+            tick_pins = (tick_pins & ~(W65816_IRQ | W65816_NMI)) | int_pins[tick++];
+            tick_pins = w65816_tick(&tick_cpu, tick_pins);
+            const uint32_t addr = W65816_GET_ADDR(tick_pins);
+            if (tick_pins & W65816_RW) {
+                W65816_SET_DATA(tick_pins, tick_mem[addr]);
+            }
+            else {
+                tick_mem[addr] = W65816_GET_DATA(tick_pins);
+            }
+            ticks++;
+        } while (!((tick_pins & W65816_VPA) && (tick_pins & W65816_VDA)));
+        const uint32_t steps = w65816_step(&step_cpu, &step_pins);
+
+        CAPTURE(i);
+        REQUIRE(steps == ticks);
+        REQUIRE((step_pins & ~(W65816_IRQ | W65816_NMI)) == (tick_pins & ~(W65816_IRQ | W65816_NMI)));
+        REQUIRE(step_cpu.PC == tick_cpu.PC);
+        REQUIRE(step_cpu.PBR == tick_cpu.PBR);
+        REQUIRE(step_cpu.C == tick_cpu.C);
+        REQUIRE(step_cpu.S == tick_cpu.S);
+        REQUIRE(step_cpu.P == tick_cpu.P);
+        REQUIRE(step_cpu.brk_flags == tick_cpu.brk_flags);
+    }
+    CHECK(step_mem == tick_mem);
+}
+
+TEST_CASE("decoded instructions match instruction stepping") {
+    // w65816_decode()/w65816_step_op() must behave like w65816_step(), and
+    // instructions which don't end a basic block keep bank and decoder table
+    std::vector<uint8_t> step_mem(1 << 24);
+    std::mt19937 rng(0x816);
+    for (auto& b : step_mem) {
+        b = rng() & 0xFF;
+        if (b == 0xCB || b == 0xDB) b = 0xEA;  // replace WAI/STP with NOP
+    }
+    std::vector<uint8_t> op_mem = step_mem;
+
+    w65816_t step_cpu, op_cpu;
+    w65816_desc_t step_desc = {};
+    step_desc.step.mem = step_mem.data();
+    w65816_desc_t op_desc = {};
+    op_desc.step.mem = op_mem.data();
+    uint64_t step_pins = w65816_init(&step_cpu, &step_desc);
+    uint64_t op_pins = w65816_init(&op_cpu, &op_desc);
+
+    int num_decoded = 0;
+    for (int i = 0; i < 100000; i++) {
+        const uint64_t irq = ((rng() & 7) == 0 ? W65816_IRQ : 0) | ((rng() & 15) == 0 ? W65816_NMI : 0);
+        step_pins = (step_pins & ~(W65816_IRQ | W65816_NMI)) | irq;
+        op_pins = (op_pins & ~(W65816_IRQ | W65816_NMI)) | irq;
+
+        const uint32_t step_ticks = w65816_step(&step_cpu, &step_pins);
+        uint32_t op_ticks;
+        const w65816_op_t op = w65816_decode(&op_cpu, op_pins);
+        if (op) {
+            const uint8_t opcode = W65816_GET_DATA(op_pins);
+            const uint16_t table = op_cpu.IR & 0xF000;
+            const uint8_t pbr = op_cpu.PBR;
+            op_ticks = w65816_step_op(&op_cpu, &op_pins, op);
+            if (!w65816_ends_block(opcode)) {
+                REQUIRE((op_cpu.IR & 0xF000) == table);
+                REQUIRE(op_cpu.PBR == pbr);
+            }
+            num_decoded++;
+        }
+        else {
+            op_ticks = w65816_step(&op_cpu, &op_pins);
+        }
+
+        CAPTURE(i);
+        REQUIRE(op_ticks == step_ticks);
+        REQUIRE(op_pins == step_pins);
+        REQUIRE(op_cpu.IR == step_cpu.IR);
+        REQUIRE(op_cpu.PC == step_cpu.PC);
+        REQUIRE(op_cpu.C == step_cpu.C);
+        REQUIRE(op_cpu.X == step_cpu.X);
+        REQUIRE(op_cpu.Y == step_cpu.Y);
+        REQUIRE(op_cpu.S == step_cpu.S);
+        REQUIRE(op_cpu.P == step_cpu.P);
+    }
+    CHECK(num_decoded > 0);
+    CHECK(op_mem == step_mem);
+}
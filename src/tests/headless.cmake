@@ -0,0 +1,35 @@
+# Runs a ROM through emu-headless with each instruction-stepped CPU engine and
+# checks that the cycle-stepped CPU ends up with the same PC, framebuffer and
+# RAM after the same number of clock cycles, i.e.:
+#   cmake -DHEADLESS=build/emu-headless -DROM=roms/VBI.xex -DFRAMES=60 -P headless.cmake
+# With -DHOLD_RESET=N all runs start with the CPU held in RESET for N frames.
+
+set(hold)
+if(HOLD_RESET)
+    set(hold -R ${HOLD_RESET})
+endif()
+
+foreach(engine step blocks)
+    execute_process(
+        COMMAND ${HEADLESS} -q -z ${hold} -n ${FRAMES} -e ${engine} -H ${ROM}
+        OUTPUT_VARIABLE stepped
+        OUTPUT_STRIP_TRAILING_WHITESPACE
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0 OR NOT stepped MATCHES "^ticks=([0-9]+) ")
+        message(FATAL_ERROR "${engine} engine run failed (${result}): ${stepped}")
+    endif()
+
+    execute_process(
+        COMMAND ${HEADLESS} -q -z ${hold} -t ${CMAKE_MATCH_1} -H ${ROM}
+        OUTPUT_VARIABLE cycled
+        OUTPUT_STRIP_TRAILING_WHITESPACE
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "cycle-stepped run failed (${result}): ${cycled}")
+    endif()
+
+    if(NOT cycled STREQUAL stepped)
+        message(FATAL_ERROR "${engine} engine and cycle-stepped CPU differ\n  ${stepped}\n  ${cycled}")
+    endif()
+    message(STATUS "${engine}: ${stepped}")
+endforeach()
@@ -306,6 +306,7 @@ typedef struct ui_dbg_heatmap_t {
     int autoclear_interval; /* 0: no autoclear */
     int scale;
     int cur_y;
+    bool freeze;    /* skip updating the texture, set by the host on non-refresh frames */
     bool popup_addr_valid;
     uint32_t popup_addr;
     ui_dbg_heatmapitem_t items[1<<24];     /* execution counter map */
@@ -1283,7 +1284,9 @@ static void _ui_dbg_heatmap_draw(ui_dbg_t* win) {
             _ui_dbg_heatmap_clear_all(win);
         }
     }
-    _ui_dbg_heatmap_update(win);
+    if (!hm->freeze) {
+        _ui_dbg_heatmap_update(win);
+    }
     ImGui::SetNextWindowPos(ImVec2(win->ui.init_x + win->ui.init_w, win->ui.init_y + 128), ImGuiCond_FirstUseEver);
     ImGui::SetNextWindowSize(ImVec2(292, 400), ImGuiCond_FirstUseEver);
     if (ImGui::Begin(win->ui.heatmap.title, &win->ui.heatmap.open)) {
@@ -123,12 +123,13 @@ static int _ui_vram_dbg_vslider_int_target(const ImVec2& slider_min, const ImVec
     return v_min + (int)(v_new_off_f + (v_min > v_max ? -0.5f : 0.5f));
 }
 
-static void _ui_vram_dbg_resize_tex(ui_vram_debugger_t* w) {
+static bool _ui_vram_dbg_resize_tex(ui_vram_debugger_t* w) {
     int new_w = _ui_vram_dbg_pixel_w(w);
-    if (new_w == w->tex_w) return;
+    if (new_w == w->tex_w) return false;
     if (w->tex) ui_destroy_texture(w->tex);
     w->tex_w = new_w;
     w->tex = ui_create_texture(w->tex_w, w->tex_h, "vram_debugger");
+    return true;
 }
 
 static void _ui_vram_dbg_clear_pixels(ui_vram_debugger_t* w) {
@@ -694,9 +695,10 @@ void ui_vram_debugger_draw(ui_vram_debugger_t* win) {
         return;
     }
 
-    /* re-decode every frame so live memory updates show through */
-    _ui_vram_dbg_resize_tex(win);
-    _ui_vram_dbg_decode(win);
+    /* re-decode so live memory updates show through, a new texture is always filled */
+    if (_ui_vram_dbg_resize_tex(win) || !win->freeze) {
+        _ui_vram_dbg_decode(win);
+    }
 
     /* memedit-style sizing for hex inputs */
     const ImGuiStyle& style = ImGui::GetStyle();
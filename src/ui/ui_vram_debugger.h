@@ -106,6 +106,7 @@ typedef struct {
     ui_texture_t tex;
     int tex_w, tex_h;
     uint32_t* pixels; /* tex_w * tex_h RGBA8 */
+    bool freeze;      /* keep the last decoded image, set by the host on non-refresh frames */
 } ui_vram_debugger_t;
 
 void ui_vram_debugger_init(ui_vram_debugger_t* win, const ui_vram_debugger_desc_t* desc);
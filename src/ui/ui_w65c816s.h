@@ -154,7 +154,7 @@ static void _ui_w65816_regs(ui_w65816_t* win) {
         ImGui::Text("Stopped: %s", cpu->stopped == W65816_STOP_WAI ? "WAI":"STP");
     }
     ImGui::SeparatorText("Internal");
-    ImGui::Text("IR: %02X %d", cpu->IR >> 4, cpu->IR & 0xF);
+    ImGui::Text("IR: %02X %d", (cpu->IR >> 4) & 0xFF, cpu->IR & 0xF);
     ImGui::Text("AD: %04X", cpu->AD);
     ImGui::Text("PINS: %010" PRIX64, cpu->PINS);
     ui_util_b16("IRQ<<: ", cpu->irq_pip);
@@ -125,6 +125,13 @@ static void _ui_x65_draw_menu(ui_x65_t* ui) {
         if (ImGui::BeginMenu("Tools")) {
             ImGui::MenuItem("About...", NULL, &ui->show_about);
             ImGui::MenuItem(ICON_LC_LOGS " Log", 0, &ui->app_log.open);
+            if (ImGui::BeginMenu("Panel Refresh")) {
+                if (ImGui::MenuItem("Every Frame", 0, ui->refresh.hz == 0)) ui->refresh.hz = 0;
+                if (ImGui::MenuItem("30 Hz", 0, ui->refresh.hz == 30)) ui->refresh.hz = 30;
+                if (ImGui::MenuItem("10 Hz", 0, ui->refresh.hz == 10)) ui->refresh.hz = 10;
+                if (ImGui::MenuItem("When Stopped", 0, ui->refresh.hz < 0)) ui->refresh.hz = -1;
+                ImGui::EndMenu();
+            }
             ui_util_options_menu();
             if (ui->inject.menu_cb) {
                 ui->inject.menu_cb();
@@ -465,6 +472,7 @@ void ui_x65_init(ui_x65_t* ui, const ui_x65_desc_t* ui_desc) {
     ui->x65 = ui_desc->x65;
     ui->boot_cb = ui_desc->boot_cb;
     ui->inject = ui_desc->inject;
+    ui->refresh.hz = 0;
     ui_snapshot_init(&ui->snapshot, &ui_desc->snapshot);
     int x = 20, y = 20, dx = 10, dy = 10;
     {
@@ -694,6 +702,22 @@ void ui_x65_discard(ui_x65_t* ui) {
 
 void ui_x65_draw(ui_x65_t* ui, const ui_x65_frame_t* frame) {
     CHIPS_ASSERT(ui && ui->x65 && frame);
+    // heavy panels keep their last decoded view between refreshes, paced by
+    // time so the rate doesn't follow the host display refresh rate. The
+    // scopes and chip windows are immediate-mode widgets reading the live
+    // state, they have no decoded view to keep and are drawn every frame.
+    bool refresh = ui->dbg.dbg.stopped || (ui->refresh.hz == 0);
+    if (ui->refresh.hz > 0) {
+        // stepping by whole periods keeps host frame jitter from skipping refreshes
+        const double now = ImGui::GetTime();
+        const double period = 1.0 / ui->refresh.hz;
+        if ((now - ui->refresh.last) >= period) {
+            ui->refresh.last = ((now - ui->refresh.last) < (2.0 * period)) ? ui->refresh.last + period : now;
+            refresh = true;
+        }
+    }
+    ui->vram_debugger.freeze = !refresh;
+    ui->dbg.heatmap.freeze = !refresh;
     _ui_x65_draw_menu(ui);
     _ui_x65_draw_about(ui);
     ui_audio_draw(&ui->audio, ui->x65->audio.sample_pos);
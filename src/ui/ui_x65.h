@@ -119,6 +119,12 @@ typedef struct {
     ui_app_log_t app_log;
     ui_snapshot_t snapshot;
     bool show_about;
+    // heavy panels (VRAM debugger, heatmap) decode at most hz times per second,
+    // a hz of 0 decodes them every frame, a negative hz only while the CPU is stopped
+    struct {
+        int hz;
+        double last;  // ImGui time of the last refresh in seconds
+    } refresh;
 } ui_x65_t;
 
 typedef struct {
@@ -0,0 +1,45 @@
+#include "./audioring.h"
+#include <string.h>
+
+void audio_ring_init(audio_ring_t* ring) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->underruns, 0);
+    atomic_init(&ring->overruns, 0);
+}
+
+size_t audio_ring_write(audio_ring_t* ring, const float* src, size_t num_samples) {
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t free = AUDIO_RING_SIZE - (head - atomic_load_explicit(&ring->tail, memory_order_acquire));
+    if (num_samples > free) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        num_samples = free;
+    }
+    // copy in at most two parts, split at the end of the items array
+    const size_t pos = head & (AUDIO_RING_SIZE - 1);
+    const size_t first = (num_samples < AUDIO_RING_SIZE - pos) ? num_samples : AUDIO_RING_SIZE - pos;
+    memcpy(&ring->items[pos], src, first * sizeof(float));
+    memcpy(&ring->items[0], src + first, (num_samples - first) * sizeof(float));
+    atomic_store_explicit(&ring->head, head + num_samples, memory_order_release);
+    return num_samples;
+}
+
+size_t audio_ring_read(audio_ring_t* ring, float* dst, size_t num_samples) {
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const size_t count = atomic_load_explicit(&ring->head, memory_order_acquire) - tail;
+    if (num_samples > count) {
+        atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+        num_samples = count;
+    }
+    const size_t pos = tail & (AUDIO_RING_SIZE - 1);
+    const size_t first = (num_samples < AUDIO_RING_SIZE - pos) ? num_samples : AUDIO_RING_SIZE - pos;
+    memcpy(dst, &ring->items[pos], first * sizeof(float));
+    memcpy(dst + first, &ring->items[0], (num_samples - first) * sizeof(float));
+    atomic_store_explicit(&ring->tail, tail + num_samples, memory_order_release);
+    return num_samples;
+}
+
+size_t audio_ring_count(audio_ring_t* ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire)
+         - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// lock-free single-producer single-consumer ring of audio samples
+#define AUDIO_RING_SIZE 8192  // in samples, must be a power of two
+
+typedef struct {
+    _Atomic size_t head;          // next sample to write, only advanced by the producer
+    _Atomic size_t tail;          // next sample to read, only advanced by the consumer
+    _Atomic uint32_t underruns;   // reads which found less samples than requested
+    _Atomic uint32_t overruns;    // writes which dropped samples because the ring was full
+    float items[AUDIO_RING_SIZE];
+} audio_ring_t;
+
+void audio_ring_init(audio_ring_t* ring);
+// producer side, returns the number of samples written, the rest is dropped
+size_t audio_ring_write(audio_ring_t* ring, const float* src, size_t num_samples);
+// consumer side, returns the number of samples read
+size_t audio_ring_read(audio_ring_t* ring, float* dst, size_t num_samples);
+// number of samples waiting in the ring, exact only on the consumer side
+size_t audio_ring_count(audio_ring_t* ring);
@@ -0,0 +1,26 @@
+#include "./spscqueue.h"
+
+void spsc_init(spsc_queue_t* q) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+bool spsc_push(spsc_queue_t* q, uint64_t item) {
+    const size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&q->tail, memory_order_acquire) == SPSC_QUEUE_SIZE) {
+        return false;
+    }
+    q->items[head & (SPSC_QUEUE_SIZE - 1)] = item;
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool spsc_pop(spsc_queue_t* q, uint64_t* item) {
+    const size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&q->head, memory_order_acquire)) {
+        return false;
+    }
+    *item = q->items[tail & (SPSC_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// lock-free single-producer single-consumer queue of 64-bit items
+#define SPSC_QUEUE_SIZE 256  // must be a power of two
+
+typedef struct {
+    _Atomic size_t head;  // next slot to write, only advanced by the producer
+    _Atomic size_t tail;  // next slot to read, only advanced by the consumer
+    uint64_t items[SPSC_QUEUE_SIZE];
+} spsc_queue_t;
+
+void spsc_init(spsc_queue_t* q);
+// producer side, returns false if the queue is full
+bool spsc_push(spsc_queue_t* q, uint64_t item);
+// consumer side, returns false if the queue is empty
+bool spsc_pop(spsc_queue_t* q, uint64_t* item);
@@ -0,0 +1,29 @@
+#include "./triplebuffer.h"
+
+#define TB_FRESH (1U << 2)
+
+void tb_init(triple_buffer_t* tb, void* buf0, void* buf1, void* buf2) {
+    tb->buf[0] = buf0;
+    tb->buf[1] = buf1;
+    tb->buf[2] = buf2;
+    tb->back = 0;
+    atomic_init(&tb->middle, 1);
+    tb->front = 2;
+}
+
+void* tb_back(triple_buffer_t* tb) {
+    return tb->buf[tb->back];
+}
+
+void tb_publish(triple_buffer_t* tb) {
+    const uint32_t prev = atomic_exchange_explicit(&tb->middle, tb->back | TB_FRESH, memory_order_acq_rel);
+    tb->back = prev & ~TB_FRESH;
+}
+
+void* tb_front(triple_buffer_t* tb) {
+    if (atomic_load_explicit(&tb->middle, memory_order_relaxed) & TB_FRESH) {
+        const uint32_t prev = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+        tb->front = prev & ~TB_FRESH;
+    }
+    return tb->buf[tb->front];
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// lock-free triple buffer, hands the latest complete buffer from one
+// producer to one consumer without either side ever waiting
+typedef struct {
+    void* buf[3];
+    _Atomic uint32_t middle;  // index of the handoff buffer, TB_FRESH if not yet consumed
+    uint32_t back;            // owned by the producer
+    uint32_t front;           // owned by the consumer
+} triple_buffer_t;
+
+void tb_init(triple_buffer_t* tb, void* buf0, void* buf1, void* buf2);
+// producer: the buffer to fill next
+void* tb_back(triple_buffer_t* tb);
+// producer: hand the filled back buffer over to the consumer
+void tb_publish(triple_buffer_t* tb);
+// consumer: the latest published buffer, stays valid until the next call
+void* tb_front(triple_buffer_t* tb);
@@ -0,0 +1,298 @@
+/**
+ * Benchmark runner - measures emulation speed on the bundled ROMs.
+ *
+ * Runs each ROM headless for a fixed number of frames and prints one JSON
+ * object per ROM with the emulated MHz, host nanoseconds per CPU cycle and
+ * the share of host time spent in the CPU (and the rest of the machine),
+ * the CGIA and the SGU. The shares come from a second, profiled run, so the
+ * timing of the chips doesn't slow down the measured throughput:
+ *     {"rom":"MODE0_text","frames":600,"mhz":42.70,"ns_per_cycle":23.42,
+ *      "cpu_pct":71.3,"cgia_pct":20.1,"sgu_pct":8.6}
+ *
+ * The output can be stored and passed back with --baseline, ROMs running
+ * slower than the baseline by more than the threshold are flagged and the
+ * runner exits with a failure, i.e.:
+ *     build/emu-bench -o bench.jsonl
+ *     build/emu-bench --baseline bench.jsonl
+ */
+
+#include "systems/x65.h"
+
+#include <argp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BUGS_ADDRESS "https://github.com/X65/emu/issues"
+
+#define BENCH_MAX_ROMS (64)
+
+// the bundled ROMs, covering all CGIA modes, sprites, raster effects and audio
+static const char* default_roms[] = {
+    "MODE0_text",
+    "MODE1_lobo_2",
+    "MODE2_SWBoy",
+    "MODE3_Veto-the_mill",
+    "MODE6_Farfar-perso1",
+    "MODE7_mascot",
+    "sprites",
+    "raster_bars",
+    "opl",
+    "pwm_samples",
+    "SOTB",
+};
+
+static char args_doc[] = "[ROM...]";
+static struct argp_option options[] = {
+    { "frames", 'n', "N", 0, "Number of frames per ROM (default 600)" },
+    { "roms", 'd', "DIR", 0, "Directory of the bundled ROMs (default roms)" },
+    { "baseline", 'b', "FILE", 0, "Compare against results stored in FILE" },
+    { "threshold", 't', "PCT", 0, "Flag ROMs slower than the baseline by PCT percent (default 10)" },
+    { "output", 'o', "FILE", 0, "Write results to FILE instead of standard output" },
+    { "verbose", 'v', 0, 0, "Produce verbose output" },
+    { 0 }
+};
+
+struct arguments {
+    const char* roms[BENCH_MAX_ROMS];
+    int num_roms;
+    const char* roms_dir;
+    const char* baseline;
+    const char* output;
+    uint32_t frames;
+    double threshold;
+    bool verbose;
+} arguments = { { NULL }, 0, "roms", NULL, NULL, 600, 10.0, false };
+
+static error_t parse_opt(int key, char* arg, struct argp_state* argp_state) {
+    struct arguments* args = argp_state->input;
+
+    switch (key) {
+        case 'v': args->verbose = true; break;
+        case 'n': args->frames = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'd': args->roms_dir = arg; break;
+        case 'b': args->baseline = arg; break;
+        case 't': args->threshold = strtod(arg, NULL); break;
+        case 'o': args->output = arg; break;
+
+        case ARGP_KEY_ARG:
+            if (args->num_roms >= BENCH_MAX_ROMS) /* Too many arguments. */
+                argp_usage(argp_state);
+            args->roms[args->num_roms++] = arg;
+            break;
+        case ARGP_KEY_END:
+            if (args->frames == 0) argp_error(argp_state, "--frames must be positive");
+            break;
+
+        default: return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options,
+                            parse_opt,
+                            args_doc,
+                            "X65 microcomputer benchmark runner"
+                            "\v"
+                            "Report bugs to: " BUGS_ADDRESS };
+
+typedef struct {
+    uint64_t ticks;
+    double seconds;
+    double cgia_seconds;
+    double sgu_seconds;
+} bench_run_t;
+
+typedef struct {
+    char name[256];
+    bool loaded;
+    bench_run_t run;   // without profiling, for the throughput
+    bench_run_t prof;  // profiled, for the CPU, CGIA and SGU shares
+} bench_result_t;
+
+static x65_t x65;
+
+static void log_cb(
+    uint32_t log_level,
+    const char* log_id,
+    const char* filename,
+    uint32_t line_nr,
+    const char* message,
+    void* user_data) {
+    (void)filename;
+    (void)line_nr;
+    (void)user_data;
+    if (log_level > 1 && !arguments.verbose) return;
+
+    static const char* level[] = { "panic", "error", "warning", "info" };
+    fprintf(stderr, "[%s] %s: %s\n", level[log_level & 3], log_id, message);
+}
+
+static chips_range_t load_rom(const char* filename) {
+    chips_range_t data = { 0 };
+    FILE* f = fopen(filename, "rb");
+    if (!f) return data;
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data.ptr = malloc(size);
+    data.size = fread(data.ptr, 1, size, f);
+    fclose(f);
+    return data;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// a bundled ROM name resolves to DIR/NAME.xex, anything else is a path
+static void rom_path(const char* rom, char* path, size_t size) {
+    if (strchr(rom, '/') || strstr(rom, ".xex")) {
+        snprintf(path, size, "%s", rom);
+    }
+    else {
+        snprintf(path, size, "%s/%s.xex", arguments.roms_dir, rom);
+    }
+}
+
+// the name in the results, the file name without directory and extension
+static void rom_name(const char* rom, char* name, size_t size) {
+    const char* base = strrchr(rom, '/');
+    base = base ? base + 1 : rom;
+    const char* ext = strstr(base, ".xex");
+    snprintf(name, size, "%.*s", ext ? (int)(ext - base) : (int)strlen(base), base);
+}
+
+// runs the ROM for the configured frames, returns false if it can't be loaded,
+// the profiled run times the CGIA and SGU, which slows down the whole machine
+static bool run_frames(const char* path, bool profile, bench_run_t* run) {
+    x65_init(&x65, &(x65_desc_t){ .zeromem = true, .log = { .func = log_cb } });
+    chips_range_t data = load_rom(path);
+    const bool loaded = data.ptr && x65_quickload_xex(&x65, data);
+    free(data.ptr);
+    if (!loaded) {
+        x65_discard(&x65);
+        return false;
+    }
+
+    x65.prof.enabled = profile;
+    const uint32_t frame_time_us = 1000000 / MODE_V_FREQ_HZ;
+    const double start = now_seconds();
+    for (uint32_t frame = 0; frame < arguments.frames; frame++) {
+        run->ticks += x65_exec(&x65, frame_time_us);
+        uint8_t c;
+        while (rb_get(&x65.ria.uart_tx, &c)) continue;  // drop the UART output
+    }
+    run->seconds = now_seconds() - start;
+    run->cgia_seconds = x65.prof.cgia_ns * 1e-9;
+    run->sgu_seconds = x65.prof.sgu_ns * 1e-9;
+    x65_discard(&x65);
+    return true;
+}
+
+// the throughput comes from a run without profiling, the CPU, CGIA and SGU
+// shares from a second, profiled run
+static void run_rom(const char* rom, bench_result_t* res) {
+    char path[1024];
+    rom_path(rom, path, sizeof(path));
+    rom_name(rom, res->name, sizeof(res->name));
+
+    res->loaded = run_frames(path, false, &res->run) && run_frames(path, true, &res->prof);
+    if (!res->loaded) {
+        fprintf(stderr, "Error: can't load file %s\n", path);
+    }
+}
+
+// emulated MHz of a ROM in the baseline file, 0 if the ROM isn't in there
+static double baseline_mhz(const char* name) {
+    FILE* f = fopen(arguments.baseline, "r");
+    if (!f) return 0.0;
+    double mhz = 0.0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char rom[256];
+        const char* p = strstr(line, "\"mhz\":");
+        if (p && (sscanf(line, "{\"rom\":\"%255[^\"]\"", rom) == 1) && (0 == strcmp(rom, name))) {
+            mhz = strtod(p + 6, NULL);
+            break;
+        }
+    }
+    fclose(f);
+    return mhz;
+}
+
+// print the result of a ROM, returns true if it regressed against the baseline
+static bool print_result(FILE* f, const bench_result_t* res) {
+    fprintf(f, "{\"rom\":\"%s\",\"frames\":%u", res->name, arguments.frames);
+    if (!res->loaded) {
+        fputs(",\"status\":\"load_failed\"}\n", f);
+        return false;
+    }
+    const bench_run_t* run = &res->run;
+    const bench_run_t* prof = &res->prof;
+    const double mhz = run->seconds > 0 ? run->ticks / run->seconds / 1e6 : 0.0;
+    const double ns_per_cycle = run->ticks ? run->seconds * 1e9 / run->ticks : 0.0;
+    const double pct = prof->seconds > 0 ? 100.0 / prof->seconds : 0.0;
+    const double cpu_seconds = prof->seconds - prof->cgia_seconds - prof->sgu_seconds;
+    fprintf(
+        f,
+        ",\"mhz\":%.2f,\"ns_per_cycle\":%.2f,\"cpu_pct\":%.1f,\"cgia_pct\":%.1f,\"sgu_pct\":%.1f",
+        mhz,
+        ns_per_cycle,
+        cpu_seconds * pct,
+        prof->cgia_seconds * pct,
+        prof->sgu_seconds * pct);
+    bool regressed = false;
+    if (arguments.baseline) {
+        const double base = baseline_mhz(res->name);
+        if (base > 0) {
+            const double change = (mhz - base) * 100.0 / base;
+            regressed = change < -arguments.threshold;
+            fprintf(f, ",\"baseline_mhz\":%.2f,\"change_pct\":%.1f", base, change);
+            if (regressed) fputs(",\"regression\":true", f);
+        }
+    }
+    fputs("}\n", f);
+    fflush(f);
+    return regressed;
+}
+
+int main(int argc, char* argv[]) {
+    argp_parse(&argp, argc, argv, 0, NULL, &arguments);
+
+    if (arguments.num_roms == 0) {
+        arguments.num_roms = sizeof(default_roms) / sizeof(default_roms[0]);
+        memcpy(arguments.roms, default_roms, sizeof(default_roms));
+    }
+    if (arguments.baseline) {
+        FILE* f = fopen(arguments.baseline, "r");
+        if (!f) {
+            fprintf(stderr, "Error: can't open file %s\n", arguments.baseline);
+            return 1;
+        }
+        fclose(f);
+    }
+    FILE* out = stdout;
+    if (arguments.output && !(out = fopen(arguments.output, "w"))) {
+        fprintf(stderr, "Error: can't open file %s\n", arguments.output);
+        return 1;
+    }
+
+    int failed = 0, regressed = 0;
+    for (int i = 0; i < arguments.num_roms; i++) {
+        bench_result_t res = { 0 };
+        run_rom(arguments.roms[i], &res);
+        failed += !res.loaded;
+        if (print_result(out, &res)) {
+            fprintf(stderr, "Regression: %s is more than %.0f%% slower than the baseline\n", res.name, arguments.threshold);
+            regressed++;
+        }
+    }
+    if (out != stdout) fclose(out);
+    return (failed || regressed) ? 1 : 0;
+}
@@ -0,0 +1,457 @@
+/**
+ * Fleet runner - runs many ROMs headless, spread over all cores in a pool
+ * of worker processes.
+ *
+ * Reads a job list (one job per line: ROM [frames] [input-script]) and
+ * hands the jobs to the forked workers. Idle workers take the next job off
+ * a queue in shared memory, so long and short jobs balance out by
+ * themselves. Workers are processes, not threads in one process, because
+ * only one x65_t can be live per process: the firmware sources keep the
+ * CGIA, HID and API state in process globals (see x65.h). This also means
+ * a crashing ROM only takes down its own job. A job running longer than --timeout
+ * seconds is killed and reported with status "timeout".
+ *
+ * Prints one JSON object per job, in job list order:
+ *     {"rom":"roms/4BB.xex","status":"ok","frames":600,"pc":"00C0DE",
+ *      "fb_hash":"...","uart":"...","mhz":42.7}
+ *
+ * An input script has one event per line: FRAME down|up KEYCODE, or
+ * FRAME joy MASK (hex), applied before the given frame is emulated.
+ * Key codes are decimal USB HID keyboard usage IDs, like x65_key_down() takes.
+ * Empty lines and lines starting with # are skipped, in job lists too. A
+ * malformed line in the job list or an input script is reported and fails
+ * the run before any job is started.
+ */
+
+#include "systems/x65.h"
+
+#include <argp.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BUGS_ADDRESS "https://github.com/X65/emu/issues"
+
+#define FLEET_MAX_UART (64 * 1024)  // UART bytes kept per job
+
+static char args_doc[] = "JOBS_FILE";
+static struct argp_option options[] = {
+    { "frames", 'n', "N", 0, "Default number of frames per job (default 600)" },
+    { "jobs", 'j', "N", 0, "Number of worker processes (default: all cores)" },
+    { "output", 'o', "FILE", 0, "Write results to FILE instead of standard output" },
+    { "timeout", 't', "SECONDS", 0, "Wall-clock limit per job, 0 for none (default 300)" },
+    { "verbose", 'v', 0, 0, "Produce verbose output" },
+    { 0 }
+};
+
+struct arguments {
+    const char* jobs_file;
+    const char* output;
+    uint32_t frames;
+    uint32_t timeout;
+    int workers;
+    bool verbose;
+} arguments = { NULL, NULL, 600, 300, 0, false };
+
+static error_t parse_opt(int key, char* arg, struct argp_state* argp_state) {
+    struct arguments* args = argp_state->input;
+
+    switch (key) {
+        case 'v': args->verbose = true; break;
+        case 'n': args->frames = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'j': args->workers = atoi(arg); break;
+        case 'o': args->output = arg; break;
+        case 't': args->timeout = (uint32_t)strtoul(arg, NULL, 10); break;
+
+        case ARGP_KEY_ARG:
+            if (argp_state->arg_num >= 1) /* Too many arguments. */
+                argp_usage(argp_state);
+            args->jobs_file = arg;
+            break;
+        case ARGP_KEY_END:
+            if (!args->jobs_file) argp_usage(argp_state);
+            break;
+
+        default: return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options,
+                            parse_opt,
+                            args_doc,
+                            "X65 microcomputer fleet runner"
+                            "\v"
+                            "Report bugs to: " BUGS_ADDRESS };
+
+typedef struct {
+    char* rom;
+    char* input;
+    uint32_t frames;
+} fleet_job_t;
+
+typedef enum {
+    FLEET_PENDING = 0,  // not finished, worker died if still pending at the end
+    FLEET_OK,
+    FLEET_LOAD_FAILED,
+    FLEET_TIMEOUT,
+} fleet_status_t;
+
+// per job result, lives in memory shared with the workers
+typedef struct {
+    fleet_status_t status;
+    pid_t worker;  // process that took the job
+    uint32_t frames;
+    uint32_t pc;
+    uint64_t fb_hash;
+    uint64_t ticks;
+    double seconds;
+    uint32_t uart_len;
+    bool uart_truncated;
+    uint8_t uart[FLEET_MAX_UART];
+} fleet_result_t;
+
+typedef struct {
+    atomic_uint next_job;
+    fleet_result_t result[];
+} fleet_shared_t;
+
+static x65_t x65;
+
+static void log_cb(
+    uint32_t log_level,
+    const char* log_id,
+    const char* filename,
+    uint32_t line_nr,
+    const char* message,
+    void* user_data) {
+    (void)filename;
+    (void)line_nr;
+    (void)user_data;
+    if (log_level > 1 && !arguments.verbose) return;
+
+    static const char* level[] = { "panic", "error", "warning", "info" };
+    fprintf(stderr, "[%d %s] %s: %s\n", (int)getpid(), level[log_level & 3], log_id, message);
+}
+
+static chips_range_t load_file(const char* filename) {
+    chips_range_t data = { 0 };
+    FILE* f = fopen(filename, "rb");
+    if (!f) return data;
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data.ptr = malloc(size + 1);
+    data.size = fread(data.ptr, 1, size, f);
+    ((char*)data.ptr)[data.size] = '\0';
+    fclose(f);
+    return data;
+}
+
+// true if str is a whole decimal number that fits in *value
+static bool parse_uint(const char* str, uint32_t* value) {
+    char* end;
+    if (*str < '0' || *str > '9') return false;
+    const unsigned long v = strtoul(str, &end, 10);
+    if (*end != '\0' || v > UINT32_MAX) return false;
+    *value = (uint32_t)v;
+    return true;
+}
+
+// true for lines without a job or event
+static bool skip_line(const char* line) {
+    line += strspn(line, " \t\r\n");
+    return *line == '\0' || *line == '#';
+}
+
+// read the job list, reports malformed lines and returns -1 on any error
+static int load_jobs(const char* filename, fleet_job_t** jobs) {
+    FILE* f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Error: can't open file %s\n", filename);
+        return -1;
+    }
+    int num_jobs = 0, cap = 0;
+    bool failed = false;
+    unsigned line_nr = 0;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        line_nr++;
+        if (skip_line(line)) continue;
+        // ROM [frames] [input-script]
+        char rom[2048], arg[2][2048], extra[2];
+        const int n = sscanf(line, "%2047s %2047s %2047s %1s", rom, arg[0], arg[1], extra);
+        uint32_t frames = arguments.frames;
+        const char* input = NULL;
+        if (n == 2 && !parse_uint(arg[0], &frames)) {
+            input = arg[0];
+        }
+        else if (n == 3 && parse_uint(arg[0], &frames)) {
+            input = arg[1];
+        }
+        else if (n != 1 && n != 2) {
+            fprintf(stderr, "Error: %s:%u: expected ROM [frames] [input-script]\n", filename, line_nr);
+            failed = true;
+            continue;
+        }
+        if (num_jobs == cap) {
+            cap = cap ? cap * 2 : 64;
+            *jobs = realloc(*jobs, cap * sizeof(fleet_job_t));
+        }
+        (*jobs)[num_jobs++] = (fleet_job_t){
+            .rom = strdup(rom),
+            .input = input ? strdup(input) : NULL,
+            .frames = frames,
+        };
+    }
+    fclose(f);
+    return failed ? -1 : num_jobs;
+}
+
+// an input script event
+typedef struct {
+    uint32_t frame;
+    enum { FLEET_KEY_DOWN, FLEET_KEY_UP, FLEET_JOY } action;
+    uint8_t value;
+} fleet_event_t;
+
+// parse an input script line, returns 1 for an event, 0 for a line to skip, -1 if malformed
+static int parse_event(const char* line, fleet_event_t* ev) {
+    if (skip_line(line)) return 0;
+    char frame[16], action[8], value[16], extra[2];
+    if (sscanf(line, "%15s %7s %15s %1s", frame, action, value, extra) != 3) return -1;
+    if (!parse_uint(frame, &ev->frame)) return -1;
+    char* end;
+    unsigned long v;
+    if (0 == strcmp(action, "down") || 0 == strcmp(action, "up")) {
+        ev->action = (action[0] == 'd') ? FLEET_KEY_DOWN : FLEET_KEY_UP;
+        v = strtoul(value, &end, 10);
+    }
+    else if (0 == strcmp(action, "joy")) {
+        ev->action = FLEET_JOY;
+        v = strtoul(value, &end, 16);
+    }
+    else {
+        return -1;
+    }
+    if (end == value || *end != '\0' || v > 0xFF) return -1;
+    ev->value = (uint8_t)v;
+    return 1;
+}
+
+// check the input script of each job, reports malformed lines
+static bool check_inputs(const fleet_job_t* jobs, int num_jobs) {
+    bool ok = true;
+    for (int i = 0; i < num_jobs; i++) {
+        if (!jobs[i].input) continue;
+        FILE* f = fopen(jobs[i].input, "r");
+        if (!f) {
+            fprintf(stderr, "Error: can't open file %s\n", jobs[i].input);
+            ok = false;
+            continue;
+        }
+        unsigned line_nr = 0;
+        char line[256];
+        fleet_event_t ev;
+        while (fgets(line, sizeof(line), f)) {
+            line_nr++;
+            if (parse_event(line, &ev) < 0) {
+                fprintf(stderr, "Error: %s:%u: expected FRAME down|up KEYCODE or FRAME joy MASK\n", jobs[i].input, line_nr);
+                ok = false;
+            }
+        }
+        fclose(f);
+    }
+    return ok;
+}
+
+// apply the input script events for the given frame
+static void apply_input(const char* script, uint32_t frame) {
+    const char* line = script;
+    while (line && *line) {
+        char buf[256];
+        const size_t len = strcspn(line, "\n");
+        snprintf(buf, sizeof(buf), "%.*s", (int)len, line);
+        line += len + (line[len] == '\n');
+        fleet_event_t ev;
+        if (parse_event(buf, &ev) != 1 || ev.frame != frame) continue;
+        switch (ev.action) {
+            case FLEET_KEY_DOWN: x65_key_down(&x65, ev.value); break;
+            case FLEET_KEY_UP: x65_key_up(&x65, ev.value); break;
+            case FLEET_JOY: x65_joystick(&x65, ev.value, 0); break;
+        }
+    }
+}
+
+static uint64_t fb_hash(void) {
+    // FNV-1a over the visible framebuffer
+    const chips_display_info_t info = x65_display_info(&x65);
+    const uint8_t* p = (const uint8_t*)info.frame.buffer.ptr;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < info.frame.buffer.size; i++) {
+        hash = (hash ^ p[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run_job(const fleet_job_t* job, fleet_result_t* res) {
+    x65_init(&x65, &(x65_desc_t){ .zeromem = true, .log = { .func = log_cb } });
+
+    chips_range_t rom = load_file(job->rom);
+    const bool loaded = rom.ptr && x65_quickload_xex(&x65, rom);
+    free(rom.ptr);
+    chips_range_t input = { 0 };
+    if (job->input) {
+        input = load_file(job->input);
+    }
+    if (!loaded || (job->input && !input.ptr)) {
+        free(input.ptr);
+        res->status = FLEET_LOAD_FAILED;
+        return;
+    }
+
+    const uint32_t frame_time_us = 1000000 / MODE_V_FREQ_HZ;
+    const double start = now_seconds();
+    for (uint32_t frame = 0; frame < job->frames; frame++) {
+        apply_input(input.ptr, frame);
+        res->ticks += x65_exec(&x65, frame_time_us);
+        uint8_t c;
+        while (rb_get(&x65.ria.uart_tx, &c)) {
+            if (res->uart_len < FLEET_MAX_UART) {
+                res->uart[res->uart_len++] = c;
+            }
+            else {
+                res->uart_truncated = true;
+            }
+        }
+        res->frames = frame + 1;
+    }
+    res->seconds = now_seconds() - start;
+    res->pc = ((uint32_t)w65816_pb(&x65.cpu) << 16) | w65816_pc(&x65.cpu);
+    res->fb_hash = fb_hash();
+    res->status = FLEET_OK;
+    free(input.ptr);
+}
+
+static void worker(fleet_shared_t* shared, const fleet_job_t* jobs, unsigned num_jobs) {
+    unsigned idx;
+    while ((idx = atomic_fetch_add(&shared->next_job, 1)) < num_jobs) {
+        shared->result[idx].worker = getpid();
+        // SIGALRM kills the worker when the job runs over its time
+        alarm(arguments.timeout);
+        run_job(&jobs[idx], &shared->result[idx]);
+        alarm(0);
+    }
+}
+
+static bool spawn_worker(fleet_shared_t* shared, const fleet_job_t* jobs, unsigned num_jobs) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        worker(shared, jobs, num_jobs);
+        _exit(0);
+    }
+    if (pid < 0) {
+        perror("fork");
+        return false;
+    }
+    return true;
+}
+
+static void print_json_string(FILE* f, const uint8_t* s, size_t len) {
+    fputc('"', f);
+    for (size_t i = 0; i < len; i++) {
+        const uint8_t c = s[i];
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c == '\n') fputs("\\n", f);
+        else if (c == '\r') fputs("\\r", f);
+        else if (c == '\t') fputs("\\t", f);
+        else if (c < 0x20 || c >= 0x7F) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void print_result(FILE* f, const fleet_job_t* job, const fleet_result_t* res) {
+    static const char* status[] = { "crashed", "ok", "load_failed", "timeout" };
+    fputs("{\"rom\":", f);
+    print_json_string(f, (const uint8_t*)job->rom, strlen(job->rom));
+    fprintf(f, ",\"status\":\"%s\",\"frames\":%u", status[res->status], res->frames);
+    if (res->status == FLEET_OK) {
+        fprintf(f, ",\"pc\":\"%06X\",\"fb_hash\":\"%016llX\",\"uart\":", res->pc, (unsigned long long)res->fb_hash);
+        print_json_string(f, res->uart, res->uart_len);
+        if (res->uart_truncated) fputs(",\"uart_truncated\":true", f);
+        fprintf(f, ",\"mhz\":%.2f", res->seconds > 0 ? res->ticks / res->seconds / 1e6 : 0.0);
+    }
+    fputs("}\n", f);
+}
+
+int main(int argc, char* argv[]) {
+    argp_parse(&argp, argc, argv, 0, NULL, &arguments);
+
+    fleet_job_t* jobs = NULL;
+    const int num_jobs = load_jobs(arguments.jobs_file, &jobs);
+    if (num_jobs < 0 || !check_inputs(jobs, num_jobs)) {
+        return 1;
+    }
+    FILE* out = stdout;
+    if (arguments.output && !(out = fopen(arguments.output, "w"))) {
+        fprintf(stderr, "Error: can't open file %s\n", arguments.output);
+        return 1;
+    }
+
+    int workers = arguments.workers > 0 ? arguments.workers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers > num_jobs) workers = num_jobs;
+
+    const size_t shared_size = sizeof(fleet_shared_t) + num_jobs * sizeof(fleet_result_t);
+    fleet_shared_t* shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    atomic_init(&shared->next_job, 0);
+
+    fflush(NULL);
+    for (int i = 0; i < workers; i++) {
+        if (!spawn_worker(shared, jobs, num_jobs)) break;
+    }
+    int wstatus;
+    pid_t pid;
+    while ((pid = wait(&wstatus)) > 0) {
+        const bool timeout = WIFSIGNALED(wstatus) && WTERMSIG(wstatus) == SIGALRM;
+        for (int i = 0; i < num_jobs; i++) {
+            if (shared->result[i].worker == pid) {
+                if (timeout && shared->result[i].status == FLEET_PENDING) {
+                    shared->result[i].status = FLEET_TIMEOUT;
+                }
+                shared->result[i].worker = 0;  // the pid may be reused by a new worker
+            }
+        }
+        // a worker that dies leaves its job pending, replace it while there is work left
+        const bool crashed = !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0;
+        if (crashed && atomic_load(&shared->next_job) < (unsigned)num_jobs) {
+            spawn_worker(shared, jobs, num_jobs);
+        }
+    }
+
+    bool all_ok = true;
+    for (int i = 0; i < num_jobs; i++) {
+        print_result(out, &jobs[i], &shared->result[i]);
+        all_ok &= shared->result[i].status == FLEET_OK;
+    }
+    if (out != stdout) fclose(out);
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+/**
+ * Headless X65 runner - no window, no audio device, no UI.
+ *
+ * Runs a ROM at maximum speed for a number of frames, or until the CPU
+ * fetches an opcode from a given address, or a RAM location holds a given
+ * value. The final framebuffer, the produced audio and the UART output
+ * can be written to files, i.e.:
+ *     build/emu-headless -z -n 300 -S shot.ppm -u uart.txt rom.xex
+ *
+ * With --hash the final clock cycle count, PC and framebuffer and RAM
+ * hashes are printed, to compare runs of the CPU engines, i.e.:
+ *     build/emu-headless -z -n 60 -H rom.xex
+ *     build/emu-headless -z -t <cycles of the first run> -H rom.xex
+ *
+ * With --hold-reset the CPU is kept in RESET for the first frames, as on a
+ * machine which is powered on before the ROM gets started.
+ */
+
+#include "systems/x65.h"
+
+#include <argp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define BUGS_ADDRESS "https://github.com/X65/emu/issues"
+
+static char args_doc[] = "ROM.xex";
+static struct argp_option options[] = {
+    { "frames", 'n', "N", 0, "Run for N frames (0 = until a stop condition)" },
+    { "until-pc", 'p', "HEX", 0, "Stop when the CPU fetches an opcode from address" },
+    { "until-mem", 'm', "HEX=HEX", 0, "Stop when RAM address holds value (checked every frame)" },
+    { "until-tick", 't', "N", 0, "Stop after N clock cycles (runs cycle-stepped)" },
+    { "cycle-stepped", 'c', 0, 0, "Run the CPU one clock cycle at a time, as under a debugger" },
+    { "engine", 'e', "ENGINE", 0, "CPU engine: step (default) or blocks" },
+    { "hold-reset", 'R', "N", 0, "Hold the CPU in RESET for the first N frames" },
+    { "zero-mem", 'z', 0, 0, "Fill memory with zeros" },
+    { "screenshot", 'S', "FILE", 0, "Write final framebuffer to FILE (PPM)" },
+    { "audio", 'A', "FILE", 0, "Write audio output to FILE (WAV)" },
+    { "uart", 'u', "FILE", 0, "Write UART output to FILE (- for stdout)" },
+    { "dump", 'd', "HEX", 0, "Print memory value before exit" },
+    { "hash", 'H', 0, 0, "Print clock cycles, PC, framebuffer and RAM hashes before exit" },
+    { "quiet", 'q', 0, 0, "Don't produce output" },
+    { "silent", 's', 0, OPTION_ALIAS },
+    { "verbose", 'v', 0, 0, "Produce verbose output" },
+    { 0 }
+};
+
+struct arguments {
+    const char* rom;
+    uint32_t frames, hold_reset;
+    int64_t until_pc, until_mem_addr, dump;
+    uint64_t until_tick;
+    uint8_t until_mem_val;
+    bool zeromem, silent, verbose, cycle_stepped, hash;
+    x65_cpu_engine_t cpu_engine;
+    const char *screenshot, *audio, *uart;
+} arguments = { NULL, 0, 0, -1, -1, -1, 0, 0, false, false, false, false, false, X65_CPU_ENGINE_STEP, NULL, NULL, NULL };
+
+static error_t parse_opt(int key, char* arg, struct argp_state* argp_state) {
+    struct arguments* args = argp_state->input;
+    char* end;
+
+    switch (key) {
+        case 'q':
+        case 's': args->silent = true; break;
+        case 'v': args->verbose = true; break;
+        case 'z': args->zeromem = true; break;
+
+        case 'n': args->frames = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'p': args->until_pc = strtoul(arg, NULL, 16) & 0xFFFFFF; break;
+        case 'm':
+            args->until_mem_addr = strtoul(arg, &end, 16) & 0xFFFFFF;
+            if (*end != '=') argp_error(argp_state, "--until-mem expects ADDR=VALUE");
+            args->until_mem_val = (uint8_t)strtoul(end + 1, NULL, 16);
+            break;
+        case 't': args->until_tick = strtoull(arg, NULL, 10); break;
+        case 'c': args->cycle_stepped = true; break;
+        case 'R': args->hold_reset = (uint32_t)strtoul(arg, NULL, 10); break;
+        case 'e':
+            if (!strcmp(arg, "step")) args->cpu_engine = X65_CPU_ENGINE_STEP;
+            else if (!strcmp(arg, "blocks")) args->cpu_engine = X65_CPU_ENGINE_BLOCKS;
+            else argp_error(argp_state, "--engine expects step or blocks");
+            break;
+        case 'd': args->dump = strtoul(arg, NULL, 16) & 0xFFFFFF; break;
+        case 'H': args->hash = true; break;
+        case 'S': args->screenshot = arg; break;
+        case 'A': args->audio = arg; break;
+        case 'u': args->uart = arg; break;
+
+        case ARGP_KEY_ARG:
+            if (argp_state->arg_num >= 1) /* Too many arguments. */
+                argp_usage(argp_state);
+            args->rom = arg;
+            break;
+        case ARGP_KEY_END:
+            if (!args->rom) argp_usage(argp_state);
+            if (args->frames == 0 && args->until_pc < 0 && args->until_mem_addr < 0 && args->until_tick == 0)
+                argp_error(argp_state, "need --frames or a stop condition");
+            break;
+
+        default: return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options,
+                            parse_opt,
+                            args_doc,
+                            "X65 microcomputer headless runner"
+                            "\v"
+                            "Report bugs to: " BUGS_ADDRESS };
+
+static x65_t x65;
+static bool stopped = false;
+
+static FILE* audio_file = NULL;
+static uint32_t audio_bytes = 0;
+
+static void log_cb(
+    uint32_t log_level,
+    const char* log_id,
+    const char* filename,
+    uint32_t line_nr,
+    const char* message,
+    void* user_data) {
+    (void)filename;
+    (void)line_nr;
+    (void)user_data;
+    if (arguments.silent || (log_level > 1 && !arguments.verbose)) return;
+
+    static const char* level[] = { "panic", "error", "warning", "info" };
+    fprintf(stderr, "[%s] %s: %s\n", level[log_level & 3], log_id, message);
+}
+
+static void debug_cb(void* user_data, uint64_t pins) {
+    (void)user_data;
+    const uint64_t sync = W65816_VPA | W65816_VDA;
+    if (((pins & sync) == sync) && (W65816_GET_ADDR(pins) == (uint32_t)arguments.until_pc)) {
+        stopped = true;
+    }
+    if (arguments.until_tick && (x65.sched.now >= arguments.until_tick)) {
+        stopped = true;
+    }
+}
+
+// FNV-1a
+static uint64_t fnv1a(const uint8_t* ptr, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ ptr[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static void wav_write_u32(uint32_t v) {
+    uint8_t b[4] = { v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, (v >> 24) & 0xFF };
+    fwrite(b, 1, sizeof(b), audio_file);
+}
+static void wav_write_u16(uint16_t v) {
+    uint8_t b[2] = { v & 0xFF, (v >> 8) & 0xFF };
+    fwrite(b, 1, sizeof(b), audio_file);
+}
+
+// RIFF header for IEEE float samples, sizes are patched in wav_close()
+static void wav_header(uint32_t data_bytes) {
+    fwrite("RIFF", 1, 4, audio_file);
+    wav_write_u32(36 + data_bytes);
+    fwrite("WAVEfmt ", 1, 8, audio_file);
+    wav_write_u32(16);
+    wav_write_u16(3);  // WAVE_FORMAT_IEEE_FLOAT
+    wav_write_u16(SGU_AUDIO_CHANNELS);
+    wav_write_u32(SGU_CHIP_CLOCK);
+    wav_write_u32(SGU_CHIP_CLOCK * SGU_AUDIO_CHANNELS * sizeof(float));
+    wav_write_u16(SGU_AUDIO_CHANNELS * sizeof(float));
+    wav_write_u16(8 * sizeof(float));
+    fwrite("data", 1, 4, audio_file);
+    wav_write_u32(data_bytes);
+}
+
+static void wav_close(void) {
+    fseek(audio_file, 0, SEEK_SET);
+    wav_header(audio_bytes);
+    fclose(audio_file);
+}
+
+static void push_audio(const float* samples, int num_samples, void* user_data) {
+    (void)user_data;
+    audio_bytes += fwrite(samples, sizeof(float), num_samples, audio_file) * sizeof(float);
+}
+
+static bool write_screenshot(const char* filename) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) return false;
+    const chips_display_info_t info = x65_display_info(&x65);
+    const int width = info.frame.dim.width;
+    const int height = info.frame.dim.height;
+    const uint8_t* src = (const uint8_t*)info.frame.buffer.ptr;
+    const uint32_t* palette = (const uint32_t*)info.palette.ptr;
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    for (int i = 0; i < width * height; i++, src += info.frame.bytes_per_pixel) {
+        if (palette) {
+            const uint32_t c = palette[*src];  // color index -> RGB
+            const uint8_t rgb[3] = { c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF };
+            fwrite(rgb, 1, 3, f);
+        }
+        else {
+            fwrite(src, 1, 3, f);  // RGBA8 -> RGB
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static void drain_uart(FILE* f) {
+    uint8_t c;
+    while (rb_get(&x65.ria.uart_tx, &c)) {
+        if (f) fputc(c, f);
+    }
+}
+
+static chips_range_t load_rom(const char* filename) {
+    chips_range_t data = { 0 };
+    FILE* f = fopen(filename, "rb");
+    if (!f) return data;
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data.ptr = malloc(size);
+    data.size = fread(data.ptr, 1, size, f);
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char* argv[]) {
+    argp_parse(&argp, argc, argv, 0, NULL, &arguments);
+
+    if (arguments.audio) {
+        audio_file = fopen(arguments.audio, "wb");
+        if (!audio_file) {
+            fprintf(stderr, "Error: can't open file %s\n", arguments.audio);
+            return 1;
+        }
+        wav_header(0);
+    }
+    FILE* uart_file = NULL;
+    if (arguments.uart) {
+        uart_file = strcmp(arguments.uart, "-") ? fopen(arguments.uart, "wb") : stdout;
+        if (!uart_file) {
+            fprintf(stderr, "Error: can't open file %s\n", arguments.uart);
+            return 1;
+        }
+    }
+
+    const bool cycle_stepped = arguments.cycle_stepped || arguments.until_pc >= 0 || arguments.until_tick;
+    const x65_desc_t desc = {
+        .zeromem = arguments.zeromem,
+        .cpu_engine = arguments.cpu_engine,
+        .debug = {
+            .callback = { .func = cycle_stepped ? debug_cb : NULL },
+            .stopped = &stopped,
+        },
+        .audio = {
+            .callback = { .func = audio_file ? push_audio : NULL },
+            .sample_rate = SGU_CHIP_CLOCK,
+        },
+        .log = { .func = log_cb },
+    };
+    x65_init(&x65, &desc);
+
+    chips_range_t rom = load_rom(arguments.rom);
+    if (!rom.ptr) {
+        fprintf(stderr, "Error: can't open file %s\n", arguments.rom);
+        return 1;
+    }
+    const bool loaded = x65_quickload_xex(&x65, rom);
+    free(rom.ptr);
+    if (!loaded) {
+        fprintf(stderr, "Error: can't load file %s\n", arguments.rom);
+        return 1;
+    }
+
+    // the loaded reset vector starts the CPU right away, unless held in RESET
+    const bool running = x65.running;
+    if (arguments.hold_reset) {
+        x65_set_running(&x65, false);
+    }
+
+    const uint32_t frame_time_us = 1000000 / MODE_V_FREQ_HZ;
+    uint32_t frame = 0;
+    while (!stopped && (arguments.frames == 0 || frame < arguments.frames)) {
+        if (arguments.hold_reset && frame == arguments.hold_reset) {
+            x65_set_running(&x65, running);
+        }
+        x65_exec(&x65, frame_time_us);
+        drain_uart(uart_file);
+        frame++;
+        if (arguments.until_mem_addr >= 0 && x65.ram[arguments.until_mem_addr] == arguments.until_mem_val) {
+            stopped = true;
+        }
+    }
+
+    if (!arguments.silent) {
+        fprintf(stderr, "%s after %u frames\n", stopped ? "Stopped" : "Finished", frame);
+    }
+    if (arguments.dump >= 0) {
+        printf("%02X\n", x65.ram[arguments.dump]);
+    }
+    if (arguments.hash) {
+        const chips_display_info_t info = x65_display_info(&x65);
+        printf("ticks=%llu pc=%02X%04X fb=%016llx ram=%016llx\n",
+               (unsigned long long)x65.sched.now,
+               x65.cpu.PBR,
+               x65.cpu.PC,
+               (unsigned long long)fnv1a(info.frame.buffer.ptr, info.frame.buffer.size),
+               (unsigned long long)fnv1a(x65.ram, sizeof(x65.ram)));
+    }
+    if (uart_file && uart_file != stdout) fclose(uart_file);
+    if (audio_file) wav_close();
+    if (arguments.screenshot && !write_screenshot(arguments.screenshot)) {
+        fprintf(stderr, "Error: can't write file %s\n", arguments.screenshot);
+        return 1;
+    }
+
+    // a requested stop condition that never triggered is a failure
+    const bool want_stop = arguments.until_pc >= 0 || arguments.until_mem_addr >= 0 || arguments.until_tick;
+    return (want_stop && !stopped) ? 1 : 0;
+}
@@ -1,13 +1,11 @@
 /*
     Emu - X65 emulator
 */
-#define CHIPS_IMPL
 #include "chips/chips_common.h"
 #include "common.h"
 #include "chips/w65c816s.h"
 #include "chips/clk.h"
 #include "chips/beeper.h"
-#undef CHIPS_IMPL
 #include "systems/x65.h"
 #if defined(CHIPS_USE_UI)
     #define UI_DBG_USE_W65C816S
@@ -38,6 +36,8 @@ extern void segfault_handler(int sig);
 #include "./args.h"
 #include "./dap.h"
 #include "./hid.h"
+#include "./emu_thread.h"
+#include "util/audioring.h"
 
 extern const char* GIT_TAG;
 extern const char* GIT_REV;
@@ -58,8 +58,12 @@ typedef struct {
 static struct {
     x65_t x65;
     uint32_t frame_time_us;
+    uint64_t frame_start_time;  // host time of the last x65_exec(), input events are timed from it
     uint32_t ticks;
     double emu_time_ms;
+    bool warp;
+    uint32_t run_ahead;  // number of frames shown ahead of the machine
+    x65_runahead_t runahead;
 #ifdef CHIPS_USE_UI
     ui_x65_t ui;
     struct {
@@ -69,8 +73,33 @@ static struct {
     x65_snapshot_t snapshots[UI_SNAPSHOT_MAX_SLOTS];
 #endif
     SpeexResamplerState* resampler;
+    // samples travel from the machine to the audio device stream callback
+    // through a lock-free ring, the audio thread resamples them to the device rate
+    struct {
+        audio_ring_t ring;
+        float in[AUDIO_RING_SIZE];  // ring samples not yet consumed by the resampler
+        uint32_t in_frames;
+        uint32_t out_rate;  // current resampler output rate
+        atomic_bool ready;  // resampler is set up, the stream callback may run before that
+    } audio;
+    // audio pacing, the resampling ratio follows the audio ring fill level
+    struct {
+        bool enabled;
+        bool refill;  // ring ran dry, output silence until it is half full again
+        int step;     // current resampling ratio step, PACING_STEPS / 2 is 1:1
+    } pacing;
 } state;
 
+static void set_warp(bool warp);
+static uint32_t input_offset_us(void);
+static void app_log(
+    uint32_t log_level,
+    const char* log_id,
+    const char* filename,
+    uint32_t line_nr,
+    const char* message,
+    void* user_data);
+
 #ifdef CHIPS_USE_UI
 static void ui_draw_cb(const ui_draw_info_t* draw_info);
 static void ui_save_settings_cb(ui_settings_t* settings);
@@ -80,6 +109,7 @@ static bool ui_load_snapshot(size_t slot_index);
 static void ui_load_snapshots_from_storage(void);
 static void web_boot(void);
 static void web_reset(void);
+static void web_warp(bool enable);
 static bool web_ready(void);
 static bool web_load(chips_range_t data);
 static void web_input(const char* text);
@@ -108,29 +138,96 @@ static void* labels = NULL;
 #define BORDER_RIGHT      (8)
 #define BORDER_BOTTOM     (32)
 #define LOAD_DELAY_FRAMES (6)
+#define PACING_MAX_DELTA  (0.005)  // maximum deviation of the resampling ratio
+#define PACING_STEPS      (16)     // resampling ratio steps from fastest to slowest
+#define RUN_AHEAD_MAX     (8)      // maximum number of run-ahead frames
+
+// Dynamic rate control: stretch the resampler output while the audio ring is
+// less than half full and shrink it while it is fuller, so latency stays
+// bounded without drifting into underruns. The ratio moves in PACING_STEPS
+// steps, and only once the fill level is well past the current step, so the
+// resampler isn't reconfigured on every callback. Returns false while the
+// output stays silent to let a drained ring fill up to the target again.
+static bool update_audio_pacing(void) {
+    const size_t count = audio_ring_count(&state.audio.ring);
+    if (count == 0) {
+        state.pacing.refill = true;
+    }
+    else if (state.pacing.refill && (count >= AUDIO_RING_SIZE / 2)) {
+        state.pacing.refill = false;
+    }
+    if (state.pacing.refill) {
+        return false;
+    }
+    const double pos = (double)count * PACING_STEPS / AUDIO_RING_SIZE;
+    const double dist = pos - state.pacing.step;
+    if ((dist > 0.75) || (dist < -0.75)) {
+        state.pacing.step = (int)(pos + 0.5);
+        const double ratio = 1.0 + PACING_MAX_DELTA * (1.0 - 2.0 * state.pacing.step / PACING_STEPS);
+        state.audio.out_rate = (uint32_t)(saudio_sample_rate() * ratio + 0.5);
+        speex_resampler_set_rate(state.resampler, SGU_CHIP_CLOCK, state.audio.out_rate);
+    }
+    return true;
+}
+
+// resample from the audio ring into dst, returns the number of samples produced
+static size_t resample_audio(float* dst, size_t num_samples) {
+    float* in = state.audio.in;
+    size_t out_pos = 0;
+    while (out_pos < num_samples) {
+        // top up the pending input to what the remaining output needs
+        const uint64_t out_left = (num_samples - out_pos) / SGU_AUDIO_CHANNELS;
+        uint64_t need = (out_left * SGU_CHIP_CLOCK + state.audio.out_rate - 1) / state.audio.out_rate + 1;
+        if (need > AUDIO_RING_SIZE / SGU_AUDIO_CHANNELS) {
+            need = AUDIO_RING_SIZE / SGU_AUDIO_CHANNELS;
+        }
+        if (need > state.audio.in_frames) {
+            float* in_end = in + state.audio.in_frames * SGU_AUDIO_CHANNELS;
+            const size_t want = (need - state.audio.in_frames) * SGU_AUDIO_CHANNELS;
+            state.audio.in_frames += audio_ring_read(&state.audio.ring, in_end, want) / SGU_AUDIO_CHANNELS;
+        }
+        spx_uint32_t in_frames = state.audio.in_frames;
+        spx_uint32_t out_frames = (spx_uint32_t)out_left;
+        speex_resampler_process_interleaved_float(state.resampler, in, &in_frames, dst + out_pos, &out_frames);
+        state.audio.in_frames -= in_frames;
+        memmove(in, in + in_frames * SGU_AUDIO_CHANNELS, state.audio.in_frames * SGU_AUDIO_CHANNELS * sizeof(float));
+        out_pos += out_frames * SGU_AUDIO_CHANNELS;
+        if (out_frames == 0) {
+            break;  // the ring ran dry
+        }
+    }
+    return out_pos;
+}
 
-// audio-streaming callback
+// audio-streaming callback, called by the machine on the emulation thread
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    spx_uint32_t in_frames = num_samples / SGU_AUDIO_CHANNELS;
-    if (!state.resampler) {
-        saudio_push(samples, in_frames);
-        return;
+    audio_ring_write(&state.audio.ring, samples, (size_t)num_samples);
+}
+
+// audio device stream callback, called on the audio thread
+static void stream_audio(float* buffer, int num_frames, int num_channels) {
+    assert(num_channels == SGU_AUDIO_CHANNELS);
+    const size_t num_samples = (size_t)num_frames * SGU_AUDIO_CHANNELS;
+    size_t out_pos = 0;
+    if (atomic_load(&state.audio.ready) && (!state.pacing.enabled || update_audio_pacing())) {
+        out_pos = state.resampler ? resample_audio(buffer, num_samples)
+                                  : audio_ring_read(&state.audio.ring, buffer, num_samples);
     }
-    spx_uint32_t out_frames = X65_MAX_AUDIO_SAMPLES / SGU_AUDIO_CHANNELS;
-    static float buf[X65_MAX_AUDIO_SAMPLES];
-    speex_resampler_process_interleaved_float(state.resampler, samples, &in_frames, buf, &out_frames);
-    saudio_push(buf, out_frames);
+    memset(buffer + out_pos, 0, (num_samples - out_pos) * sizeof(float));
 }
 
 // get x65_desc_t struct based on joystick type
 x65_desc_t x65_desc(x65_joystick_type_t joy_type) {
     return (x65_desc_t) {
         .joystick_type = joy_type,
+        .cpu_engine = sargs_equals("cpu", "blocks") ? X65_CPU_ENGINE_BLOCKS : X65_CPU_ENGINE_STEP,
+        .zeromem = arguments.zeromem,
         .audio = {
             .callback = { .func = push_audio },
             .sample_rate = saudio_sample_rate(),
         },
+        .log = { .func = app_log },
 #if defined(CHIPS_USE_UI)
         .debug = ui_x65_get_debug(&state.ui)
 #endif
@@ -197,14 +294,23 @@ void app_init(void) {
         sapp_gl_get_major_version(),
         sapp_gl_get_minor_version());
 #endif
+    audio_ring_init(&state.audio.ring);
     saudio_setup(&(saudio_desc){
         .sample_rate = SGU_CHIP_CLOCK,
         .num_channels = SGU_AUDIO_CHANNELS,
+        .stream_cb = stream_audio,
         .logger.func = slog_func,
     });
-    state.resampler = SGU_CHIP_CLOCK == saudio_sample_rate()
+    // pacing needs the resampler even when the device runs at the chip clock
+    const bool audio_pacing = sargs_equals("pacing", "audio") && saudio_isvalid();
+    state.audio.out_rate = (uint32_t)saudio_sample_rate();
+    state.resampler = (SGU_CHIP_CLOCK == saudio_sample_rate()) && !audio_pacing
         ? NULL
         : speex_resampler_init(SGU1_AUDIO_CHANNELS, SGU_CHIP_CLOCK, saudio_sample_rate(), 4, 0);
+    state.pacing.refill = true;
+    state.pacing.step = PACING_STEPS / 2;
+    state.pacing.enabled = audio_pacing;
+    atomic_store(&state.audio.ready, true);
     x65_joystick_type_t joy_type = arguments.joy ? X65_JOYSTICKTYPE_DIGITAL_1 : X65_JOYSTICKTYPE_NONE;
     if (sargs_exists("joystick")) {
         if (sargs_equals("joystick", "digital_1")) {
@@ -232,6 +338,11 @@ void app_init(void) {
             .bottom = BORDER_BOTTOM,
         },
         .display_info = x65_display_info(&state.x65),
+        // a native-resolution framebuffer gets its pixels repeated on the GPU
+        .frame_scale = {
+            .width = CGIA_DISPLAY_WIDTH / CGIA_FRAMEBUFFER_WIDTH,
+            .height = CGIA_DISPLAY_HEIGHT / CGIA_FRAMEBUFFER_HEIGHT,
+        },
     });
     if (arguments.crt) {
         gfx_crt_set_enabled(true);
@@ -291,6 +402,7 @@ void app_init(void) {
         .funcs = {
             .boot = web_boot,
             .reset = web_reset,
+            .warp = web_warp,
             .ready = web_ready,
             .load = web_load,
             .input = web_input,
@@ -315,6 +427,7 @@ void app_init(void) {
         .funcs = {
             .boot = web_boot,
             .reset = web_reset,
+            .warp = web_warp,
             .ready = web_ready,
             .load = web_load,
             .input = web_input,
@@ -359,19 +472,73 @@ void app_init(void) {
             fprintf(stderr, "Bad breakpoint opcode %s\n", sargs_value("break"));
         }
     }
+    x65_set_frame_skip(&state.x65, arguments.frame_skip);
+#ifndef USE_WEB
+    if (!sargs_equals("thread", "no")) {
+        emu_thread_start(&state.x65);
+    }
+#endif
+    set_warp(arguments.warp);
+    if (arguments.run_ahead > 0) {
+        LOG_WARNING("Run-ahead is experimental, firmware state outside the rollback may diverge");
+        state.run_ahead = arguments.run_ahead < RUN_AHEAD_MAX ? arguments.run_ahead : RUN_AHEAD_MAX;
+        x65_runahead_init(&state.runahead);
+        emu_thread_set_run_ahead(state.run_ahead);
+    }
 }
 
 static void handle_file_loading(void);
 static void send_keybuf_input(void);
-static void draw_status_bar(void);
+static void draw_status_bar(const emu_thread_stats_t* stats);
 
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
+    emu_thread_drain_log(ui_app_log_add);
+    if (emu_thread_running()) {
+        // the machine runs on its own thread, the status bar shows the stats published
+        // with the last frame, the machine is only taken when there is work touching it
+        const emu_thread_stats_t stats = emu_thread_stats();
+        state.ticks = stats.ticks;
+        state.emu_time_ms = stats.emu_time_ms;
+        draw_status_bar(&stats);
+        handle_file_loading();
+        if (sdl_has_events()) {
+            emu_thread_lock();
+            sdl_poll_events();
+            emu_thread_unlock();
+        }
+#ifdef USE_DAP
+        if (dap_pending()) {
+            emu_thread_lock();
+            dap_process();
+            emu_thread_unlock();
+        }
+#endif
+        send_keybuf_input();
+        gfx_draw(emu_thread_display_info());
+        return;
+    }
     const uint64_t emu_start_time = stm_now();
-    state.ticks = x65_exec(&state.x65, state.frame_time_us);
+    state.frame_start_time = emu_start_time;
+    if (state.warp) {
+        // most of the host frame, leaving time to present
+        state.ticks = x65_exec_warp(&state.x65, state.frame_time_us * 3 / 4);
+    }
+    else if (state.run_ahead > 0) {
+        state.ticks = x65_exec_runahead(&state.x65, &state.runahead, state.frame_time_us, state.run_ahead);
+    }
+    else {
+        state.ticks = x65_exec(&state.x65, state.frame_time_us);
+    }
+    if (!state.warp) {
+        x65_adapt_frame_skip(&state.x65, state.frame_time_us, (uint32_t)stm_us(stm_since(emu_start_time)));
+    }
     state.emu_time_ms = stm_ms(stm_since(emu_start_time));
-    draw_status_bar();
+    emu_thread_stats_t stats = { 0 };
+    emu_thread_machine_stats(&state.x65, &stats);
+    draw_status_bar(&stats);
     gfx_draw(x65_display_info(&state.x65));
+    x65_display_presented(&state.x65);
     handle_file_loading();
     send_keybuf_input();
     sdl_poll_events();
@@ -408,6 +575,14 @@ void app_input(const sapp_event* event) {
         }
     }
 #endif
+    // Warp mode toggle hotkey, ALT+W, swallowed like the fullscreen toggle.
+    if ((event->type == SAPP_EVENTTYPE_KEY_DOWN || event->type == SAPP_EVENTTYPE_KEY_UP)
+        && event->key_code == SAPP_KEYCODE_W && (event->modifiers & SAPP_MODIFIER_ALT)) {
+        if (event->type == SAPP_EVENTTYPE_KEY_DOWN && !event->key_repeat) {
+            set_warp(!state.warp);
+        }
+        return;
+    }
 #ifdef CHIPS_USE_UI
     if (ui_input(event)) {
         // input was handled by UI
@@ -415,9 +590,21 @@ void app_input(const sapp_event* event) {
     }
 #endif
     switch (event->type) {
-        case SAPP_EVENTTYPE_KEY_DOWN: x65_key_down(&state.x65, event->key_code); break;
+        case SAPP_EVENTTYPE_KEY_DOWN:
+            if (emu_thread_running()) {
+                emu_thread_post(EMU_THREAD_KEY_DOWN, hid_usb_keycode(event->key_code));
+            }
+            else {
+                x65_input(&state.x65, X65_INPUT_KEY_DOWN, hid_usb_keycode(event->key_code), input_offset_us());
+            }
+            break;
         case SAPP_EVENTTYPE_KEY_UP:
-            x65_key_up(&state.x65, event->key_code);
+            if (emu_thread_running()) {
+                emu_thread_post(EMU_THREAD_KEY_UP, hid_usb_keycode(event->key_code));
+            }
+            else {
+                x65_input(&state.x65, X65_INPUT_KEY_UP, hid_usb_keycode(event->key_code), input_offset_us());
+            }
             if (event->key_code == SAPP_KEYCODE_Q) {
                 if (event->modifiers == SAPP_MODIFIER_SUPER || event->modifiers == SAPP_MODIFIER_CTRL) {
                     sapp_request_quit();
@@ -429,7 +616,11 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emu_thread_stop();
     x65_discard(&state.x65);
+    if (state.run_ahead > 0) {
+        x65_runahead_discard(&state.runahead);
+    }
 #ifdef CHIPS_USE_UI
     ui_x65_discard(&state.ui);
     ui_discard();
@@ -444,15 +635,26 @@ void app_cleanup(void) {
 #endif
 }
 
+// input events arriving between frames are replayed at the same offset into the next frame
+static uint32_t input_offset_us(void) {
+    return (uint32_t)stm_us(stm_since(state.frame_start_time));
+}
+
+static void set_warp(bool warp) {
+    state.warp = warp;
+    emu_thread_set_warp(warp);
+}
+
 static void send_keybuf_input(void) {
     uint8_t key_code;
     if (0 != (key_code = keybuf_get(state.frame_time_us))) {
-        /* FIXME: this is ugly */
-        x65_joystick_type_t joy_type = state.x65.joystick_type;
-        state.x65.joystick_type = X65_JOYSTICKTYPE_NONE;
-        x65_key_down(&state.x65, key_code);
-        x65_key_up(&state.x65, key_code);
-        state.x65.joystick_type = joy_type;
+        // the keybuf characters are mapped like sokol key codes
+        key_code = hid_usb_keycode((sapp_keycode)key_code);
+        if (emu_thread_running()) {
+            emu_thread_post(EMU_THREAD_KEY_TAP, key_code);
+            return;
+        }
+        x65_input(&state.x65, X65_INPUT_KEY_TAP, key_code, input_offset_us());
     }
 }
 
@@ -466,7 +668,9 @@ static void handle_file_loading(void) {
             keybuf_put((const char*)fs_data(FS_CHANNEL_IMAGES).ptr);
         }
         else if (fs_ext(FS_CHANNEL_IMAGES, "xex")) {
+            emu_thread_lock();
             load_success = x65_quickload_xex(&state.x65, fs_data(FS_CHANNEL_IMAGES));
+            emu_thread_unlock();
         }
         if (load_success) {
             if (clock_frame_count_60hz() > (load_delay_frames + 10)) {
@@ -489,7 +693,7 @@ static void handle_file_loading(void) {
     }
 }
 
-static void draw_status_bar(void) {
+static void draw_status_bar(const emu_thread_stats_t* stats) {
     prof_push(PROF_EMU, (float)state.emu_time_ms);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
     const float frame_time = (float)state.frame_time_us * 0.001f;
@@ -507,9 +711,9 @@ static void draw_status_bar(void) {
     // joystick state
     sdtx_color1i(text_color);
     sdtx_puts("JOYSTICK: ");
-    const uint8_t joymask = x65_joystick_mask(&state.x65);
+    const uint8_t joymask = stats->joystick_mask;
     sdtx_font(1);
-    switch (state.x65.joystick_type) {
+    switch (stats->joystick_type) {
         case X65_JOYSTICKTYPE_DIGITAL_1: sdtx_puts("1 "); break;
         case X65_JOYSTICKTYPE_DIGITAL_2: sdtx_puts("2 "); break;
         case X65_JOYSTICKTYPE_DIGITAL_12: sdtx_puts("12 "); break;
@@ -534,14 +738,11 @@ static void draw_status_bar(void) {
     sdtx_font(0);
 
     // RGB LEDs
-    uint32_t* leds;
-    size_t leds_no;
-    ria816_rgb_get_leds(&leds, &leds_no);
     sdtx_color1i(text_color);
     sdtx_puts("  LEDs: ");
-    for (size_t i = 0; i < leds_no; i++) {
+    for (uint32_t i = 0; i < stats->num_leds; i++) {
         // GRB8 order ¯\_(ツ)_/¯
-        uint32_t led = leds[i];
+        uint32_t led = stats->leds[i];
         if (led != 0) {
             sdtx_color3b((led >> 8) & 0xFF, (led >> 16) & 0xFF, led & 0xFF);
             sdtx_putc(0xCF);  // filled circle
@@ -553,28 +754,40 @@ static void draw_status_bar(void) {
         sdtx_putc(' ');
     }
 
+    char frame_skip[16] = "";
+    if (stats->frame_skip_enabled) {
+        snprintf(frame_skip, sizeof(frame_skip), " skip:%u", stats->frame_skip);
+    }
     sdtx_font(0);
-    if (emu_stats.avg_val > frame_time)
+    if (emu_stats.avg_val > frame_time && !state.warp)
         sdtx_color3b(255, 32, 32);
     else
         sdtx_color3b(255, 255, 255);
     sdtx_pos(0.0f, 1.5f);
     sdtx_printf(
-        "frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d",
+        "frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d audio:%d%% (under:%u over:%u)%s%s",
         frame_time,
         emu_stats.avg_val,
         emu_stats.min_val,
         emu_stats.max_val,
-        state.ticks);
+        state.ticks,
+        (int)(audio_ring_count(&state.audio.ring) * 100 / AUDIO_RING_SIZE),
+        atomic_load(&state.audio.ring.underruns),
+        atomic_load(&state.audio.ring.overruns),
+        frame_skip,
+        state.warp ? " WARP" : "");
 }
 
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(const ui_draw_info_t* draw_info) {
+    // the UI reads and changes the machine, take it between two frames
+    emu_thread_lock();
     ui_x65_draw(
         &state.ui,
         &(ui_x65_frame_t){
             .display = draw_info->display,
         });
+    emu_thread_unlock();
 }
 
 static void ui_save_settings_cb(ui_settings_t* settings) {
@@ -647,6 +860,7 @@ static void web_boot(void) {
     clock_init();
     x65_desc_t desc = x65_desc(state.x65.joystick_type);
     x65_init(&state.x65, &desc);
+    x65_set_frame_skip(&state.x65, arguments.frame_skip);
     ui_dbg_reboot(&state.ui.dbg);
 }
 
@@ -655,6 +869,10 @@ static void web_reset(void) {
     ui_dbg_reset(&state.ui.dbg);
 }
 
+static void web_warp(bool enable) {
+    set_warp(enable);
+}
+
 static void web_dbg_connect(void) {
     gfx_disable_speaker_icon();
     state.dbg.entry_addr = 0xFFFFFFFF;
@@ -845,10 +1063,15 @@ static unsigned long djb2(const char* s) {
     return h;
 }
 
-void log_func(uint32_t log_level, const char* log_id, const char* filename, uint32_t line_nr, const char* fmt, ...) {
-    char message[512];
-
-    char* short_filename = strstr(filename, "src/");
+static void app_log(
+    uint32_t log_level,
+    const char* log_id,
+    const char* filename,
+    uint32_t line_nr,
+    const char* message,
+    void* user_data) {
+    (void)user_data;
+    const char* short_filename = strstr(filename, "src/");
     if (short_filename) {
         short_filename += 4;
     }
@@ -856,14 +1079,12 @@ void log_func(uint32_t log_level, const char* log_id, const char* filename, uint
     unsigned long log_id_hash = djb2(log_id);
     uint32_t log_item = (log_id_hash >> 32) ^ (log_id_hash & 0xFFFFFFFF);
 
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(message, sizeof(message), fmt, args);
-    message[sizeof(message) - 1] = '\0';
-    va_end(args);
-
     slog_func(log_id, log_level, log_item, message, line_nr, short_filename, NULL);
-    ui_app_log_add(log_level, log_item, log_id, message);
+    // the machine logs from the emulation thread, the UI log is only added to
+    // on the main thread, in app_frame()
+    if (!emu_thread_log(log_level, log_item, log_id, message)) {
+        ui_app_log_add(log_level, log_item, log_id, message);
+    }
 }
 
 char app_version[256];
@@ -900,9 +1121,8 @@ sapp_desc sokol_main(int argc, char* argv[]) {
         window_height = ui_setts->window_height;
     }
 
-    const chips_display_info_t info = x65_display_info(0);
-    const int default_width = info.screen.width + BORDER_LEFT + BORDER_RIGHT;
-    const int default_height = info.screen.height + BORDER_TOP + BORDER_BOTTOM;
+    const int default_width = CGIA_DISPLAY_WIDTH + BORDER_LEFT + BORDER_RIGHT;
+    const int default_height = CGIA_DISPLAY_HEIGHT + BORDER_TOP + BORDER_BOTTOM;
 
     // Use the minimum OpenGL/GLES version required by the compiled shaders to
     // maximize compatibility with older hardware.